@@ -0,0 +1,207 @@
+/* bench.c -- benchmark mode for vlock screen savers
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#if !defined(__FreeBSD__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "util.h"
+#include "bench.h"
+
+static const char *saver = NULL;
+static long frames_wanted = 0;
+static long frames = 0;
+
+/* Per frame samples: wall time spent drawing and writing the frame, CPU
+ * time and bytes written. */
+static uint64_t *render_ns = NULL;
+static uint64_t *flush_ns = NULL;
+static uint64_t *cpu_ns = NULL;
+static uint64_t *bytes = NULL;
+
+static uint64_t frame_start;
+static uint64_t frame_cpu_start;
+static uint64_t flush_start;
+static uint64_t flush_total;
+static long frame_bytes_start;
+
+/* monotonic_ns() when the saver was asked to start (VLOCK_BENCH_START), and
+ * how long it took to finish its first frame; 0 if unknown. */
+static uint64_t started = 0;
+static uint64_t first_frame_ns = 0;
+
+/* /proc/self/io, for the bytes this process wrote; -1 if unavailable. */
+static int io_fd = -1;
+
+static uint64_t cpu_time_ns(void)
+{
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) < 0)
+        return 0;
+
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Return the number of bytes written so far, or -1 if unknown.  Counts
+ * every write(), so it works for a pty as well as a file. */
+static long bytes_written(void)
+{
+    long n = io_fd >= 0 ? io_bytes_written(io_fd) : -1;
+
+    if (n >= 0)
+        return n;
+
+    /* Without /proc only the position in an output file tells. */
+    return lseek(STDOUT_FILENO, 0, SEEK_CUR);
+}
+
+static void begin_frame(void)
+{
+    frame_bytes_start = bytes_written();
+    frame_cpu_start = cpu_time_ns();
+    flush_total = 0;
+    frame_start = monotonic_ns();
+}
+
+bool bench_start(const char *name)
+{
+    const char *value = getenv("VLOCK_BENCH_FRAMES");
+    char *end;
+
+    if (value == NULL)
+        return false;
+
+    frames_wanted = strtol(value, &end, 10);
+
+    if (*end != '\0' || frames_wanted <= 0) {
+        frames_wanted = 0;
+        return false;
+    }
+
+    render_ns = calloc(frames_wanted, sizeof *render_ns);
+    flush_ns = calloc(frames_wanted, sizeof *flush_ns);
+    cpu_ns = calloc(frames_wanted, sizeof *cpu_ns);
+    bytes = calloc(frames_wanted, sizeof *bytes);
+
+    if (render_ns == NULL || flush_ns == NULL || cpu_ns == NULL
+        || bytes == NULL) {
+        frames_wanted = 0;
+        return false;
+    }
+
+    value = getenv("VLOCK_BENCH_START");
+
+    if (value != NULL)
+        started = strtoull(value, NULL, 10);
+
+    saver = name;
+    io_fd = open("/proc/self/io", O_RDONLY | O_CLOEXEC);
+    begin_frame();
+
+    return true;
+}
+
+bool bench_enabled(void)
+{
+    return frames_wanted > 0;
+}
+
+void bench_flush_begin(void)
+{
+    if (bench_enabled())
+        flush_start = monotonic_ns();
+}
+
+void bench_flush_end(void)
+{
+    if (bench_enabled())
+        flush_total += monotonic_ns() - flush_start;
+}
+
+static int compare_samples(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* Print the statistics of the samples, divided by scale. */
+static void report_samples(FILE *out, const char *metric, uint64_t *samples,
+                           long n, double scale)
+{
+    uint64_t total = 0;
+
+    qsort(samples, n, sizeof *samples, compare_samples);
+
+    for (long i = 0; i < n; i++)
+        total += samples[i];
+
+    fprintf(out, ",\"%s\":{\"mean\":%.1f,\"min\":%.1f,\"p50\":%.1f"
+            ",\"p99\":%.1f,\"max\":%.1f}",
+            metric, total / scale / n, samples[0] / scale,
+            samples[n / 2] / scale, samples[(n * 99) / 100] / scale,
+            samples[n - 1] / scale);
+}
+
+static void report(void)
+{
+    FILE *out = stderr;
+    struct rusage usage;
+
+    (void) getrusage(RUSAGE_SELF, &usage);
+
+    fprintf(out, "{\"saver\":\"%s\",\"frames\":%ld", saver, frames);
+
+    if (bytes_written() >= 0)
+        report_samples(out, "bytes", bytes, frames, 1);
+
+    report_samples(out, "render_us", render_ns, frames, 1e3);
+    report_samples(out, "flush_us", flush_ns, frames, 1e3);
+    report_samples(out, "cpu_us", cpu_ns, frames, 1e3);
+    if (first_frame_ns > 0)
+        fprintf(out, ",\"first_frame_us\":%.1f", first_frame_ns / 1e3);
+
+    fprintf(out, ",\"peak_rss_kb\":%ld}\n", usage.ru_maxrss);
+    fflush(out);
+}
+
+void bench_frame_done(void)
+{
+    uint64_t now = monotonic_ns();
+    long written = bytes_written();
+
+    flush_ns[frames] = flush_total;
+    render_ns[frames] = now - frame_start - flush_total;
+    cpu_ns[frames] = cpu_time_ns() - frame_cpu_start;
+    bytes[frames] = written >= frame_bytes_start ? written - frame_bytes_start
+                                                 : 0;
+
+    if (frames == 0 && started > 0 && now > started)
+        first_frame_ns = now - started;
+
+    if (++frames == frames_wanted) {
+        report();
+        exit(EXIT_SUCCESS);
+    }
+
+    begin_frame();
+}
@@ -0,0 +1,35 @@
+/* bench.h -- benchmark mode for vlock screen savers
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+/* With VLOCK_BENCH_FRAMES set a saver renders that many frames back to back
+ * and exits, reporting per frame statistics as a line of JSON on stderr.  If
+ * VLOCK_BENCH_START holds the monotonic_ns() of when the saver was started,
+ * the time to its first frame is reported as well.  See
+ * tests/vlock-bench-saver.c, which sets this up. */
+
+/* Called by frame_clock_init() for the saver with the given name.  Returns
+ * true if benchmark mode is on; the first frame starts now. */
+bool bench_start(const char *name);
+
+bool bench_enabled(void);
+
+/* Put around the code that writes a frame to the terminal. */
+void bench_flush_begin(void);
+void bench_flush_end(void);
+
+/* Called by frame_clock_wait() when a frame is done.  Exits after the last
+ * frame. */
+void bench_frame_done(void);
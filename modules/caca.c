@@ -41,8 +41,13 @@
 #include <caca.h>
 
 #include "process.h"
+#include "supervisor.h"
 
 #include "vlock_plugin.h"
+#include "frame_clock.h"
+#include "screen.h"
+#include "prng.h"
+#include "overlay.h"
 
 enum action { PREPARE, INIT, UPDATE, RENDER, FREE };
 
@@ -77,27 +82,85 @@ void (*fn[])(enum action, cucul_canvas_t *) =
 static int frame = 0;
 static bool abort_requested = false;
 
+/* Set when the child is continued after being suspended. */
+static volatile sig_atomic_t repaint = 0;
+
 void handle_sigterm(int __attribute__((unused)) signum)
 {
   abort_requested = true;
 }
 
+static void handle_sigcont(int __attribute__((unused)) signum)
+{
+  repaint = 1;
+}
+
 static int caca_main(void *argument);
 
+/* Set when the demos' lookup tables were filled by vlock_prepare(). */
+static bool prepared = false;
+
+/* Seed rand() and fill all demos' lookup tables. */
+static void prepare_demos(void)
+{
+  uint64_t seed;
+  unsigned int i;
+
+  /* libcaca seeds rand() on its first use.  Get that over with, so runs
+   * with VLOCK_SEED repeat. */
+  (void) cucul_rand(0, 1);
+
+  if (prng_env_seed(&seed))
+    srand((unsigned int) seed);
+
+  /* None of the demos draws on the canvas yet. */
+  for (i = 0; i < DEMOS; i++)
+    fn[i](PREPARE, NULL);
+}
+
+/* The tables take a while to compute but do not depend on the screen, so
+ * they are filled while vlock waits for the screen saver timeout, in the
+ * zygote the child is cloned from. */
+void vlock_prepare(void)
+{
+  prepare_demos();
+  prepared = true;
+}
+
 bool vlock_save(void **ctx_ptr)
 {
+  static struct resource_policy policy = {
+    .sched = RESOURCE_SCHED_IDLE,
+  };
   static struct child_process child = {
     .function = caca_main,
     .argument = NULL,
     .stdin_fd = REDIRECT_DEV_NULL,
     .stdout_fd = NO_REDIRECT,
     .stderr_fd = NO_REDIRECT,
+    .policy = &policy,
+    /* libcaca sets up its own screen in the child. */
+    .zygote_safe = true,
   };
 
+  /* Wake the saver that was suspended on the last key press, if it is still
+   * there.  It repaints the whole screen when continued. */
+  if (child.pid > 0) {
+    (void) screen_begin();
+
+    if (supervisor_resume(child.pid)) {
+      *ctx_ptr = &child;
+      return true;
+    }
+  }
+
   /* Initialize ncurses. */
-  initscr();
+  if (!screen_begin())
+    return false;
+
+  resource_policy_from_env("caca", &policy);
 
-  if (!create_child(&child))
+  if (!supervisor_spawn("caca", &child, true, NULL))
     return false;
 
   *ctx_ptr = &child;
@@ -110,11 +173,10 @@ bool vlock_save_abort(void **ctx_ptr)
   struct child_process *child = *ctx_ptr;
 
   if (child != NULL) {
-    ensure_death(child->pid);
-    /* Restore sane terminal and uninitialize ncurses. */
-    curs_set(1);
-    refresh();
-    endwin();
+    /* Keep the child for a quick resume on the next vlock_save. */
+    supervisor_suspend(child->pid);
+    /* Restore sane terminal and suspend ncurses. */
+    screen_suspend();
     *ctx_ptr = NULL;
   }
 
@@ -126,9 +188,10 @@ static int caca_main(void __attribute__((unused)) *argument)
     static caca_display_t *dp;
     static cucul_canvas_t *frontcv, *backcv, *mask;
 
-    int demo, next = -1, next_transition = DEMO_FRAMES;
-    unsigned int i;
-    int tmode = cucul_rand(0, TRANSITION_COUNT);
+    struct frame_clock clock;
+    int demo, next = -1, next_transition;
+    int tmode;
+    uint64_t seed;
 
     /* Set up two canvases, a mask, and attach a display to the front one */
     frontcv = cucul_create_canvas(0, 0);
@@ -141,17 +204,27 @@ static int caca_main(void __attribute__((unused)) *argument)
     if(!dp)
         return 1;
 
+    signal(SIGCONT, handle_sigcont);
+
     cucul_set_canvas_size(backcv, cucul_get_canvas_width(frontcv),
                                   cucul_get_canvas_height(frontcv));
     cucul_set_canvas_size(mask, cucul_get_canvas_width(frontcv),
                                 cucul_get_canvas_height(frontcv));
 
-    /* Set refresh delay.  40ms corresponds to 25 FPS. */
-    caca_set_display_time(dp, 40000);
+    /* Frames are paced by the frame clock, 25 FPS by default. */
+    caca_set_display_time(dp, 0);
+    frame_clock_init(&clock, "caca", 25);
 
-    /* Initialise all demos' lookup tables */
-    for(i = 0; i < DEMOS; i++)
-        fn[i](PREPARE, frontcv);
+    /* Initialise all demos' lookup tables, unless the zygote did.  Its
+     * children all inherit the same rand() state, so give each its own
+     * sequence unless VLOCK_SEED asks for the same one. */
+    if(!prepared)
+        prepare_demos();
+    else if(!prng_env_seed(&seed))
+        srand((unsigned int) getpid());
+
+    next_transition = DEMO_FRAMES;
+    tmode = cucul_rand(0, TRANSITION_COUNT);
 
     /* Choose a demo at random */
     demo = cucul_rand(0, DEMOS);
@@ -192,6 +265,7 @@ static int caca_main(void __attribute__((unused)) *argument)
             fn[next](UPDATE, backcv);
 
         frame++;
+        frame_clock_updated(&clock);
 
         /* Render main demo's canvas */
         fn[demo](RENDER, frontcv);
@@ -213,7 +287,27 @@ static int caca_main(void __attribute__((unused)) *argument)
             cucul_put_str(frontcv, cucul_get_canvas_width(frontcv) - 30,
                                    cucul_get_canvas_height(frontcv) - 2,
                                    " -=[ Powered by libcaca ]=- ");
+        /* libcaca draws and refreshes in one go, so it cannot leave the
+         * rows of the password prompt alone.  Pause behind the prompt and
+         * repaint everything once it is gone. */
+        if(overlay_active())
+        {
+            repaint = 1;
+            (void) frame_clock_wait(&clock);
+            continue;
+        }
+
+        if(repaint)
+        {
+            /* The screen was used for the password prompt. */
+            repaint = 0;
+            clearok(curscr, TRUE);
+        }
+
+        frame_clock_flush_begin();
         caca_refresh_display(dp);
+        frame_clock_flush_end();
+        (void) frame_clock_wait(&clock);
     }
 end:
     if(next != -1)
@@ -583,7 +677,7 @@ static void draw_ball(uint8_t *screen, unsigned int bx, unsigned int by)
     }
 }
 
-/* The moir effect */
+/* The moiré effect */
 #define DISCSIZ (XSIZ*2)
 #define DISCTHICKNESS (XSIZ*15/40)
 static uint8_t disc[DISCSIZ * DISCSIZ];
@@ -44,47 +44,102 @@
 
 #include "cmatrix.h"
 #include "process.h"
+#include "supervisor.h"
 #include "vlock_plugin.h"
 #include "info_box.h"
+#include "render.h"
+#include "screen.h"
+#include "frame_clock.h"
+#include "prng.h"
+#include "matrix.h"
 
 
 static int cmatrix_main(void *argument);
+bool var_init(void);
 
 /* Global variables */
 int console = 0;
 int xwindow = 0;
-cmatrix **matrix = (cmatrix **) NULL;
-int *length = NULL;  /* Length of cols in each line */
-int *spaces = NULL;  /* Spaces left to fill */
-int *updates = NULL; /* What does this do again? */
-int *colors = NULL;  /* Per-stream color (used in rainbow mode) */
+static struct matrix matrix;         /* The streams, see matrix.h */
 volatile sig_atomic_t signal_status = 0; /* Indicates a caught signal */
+static volatile sig_atomic_t repaint = 0; /* Continued after a suspend */
+static struct prng rng;              /* Seeded again in every child */
+/* Screen size the matrix was made for in vlock_prepare(), 0 if it was not. */
+static int prepared_lines = 0;
+static int prepared_cols = 0;
 
 
+/* Set up ncurses.  Done by vlock-main, and again by the child if it was
+ * started by the zygote and has no screen of its own yet. */
+static bool init_screen(void)
+{
+    if (!screen_begin())
+        return false;
+
+    signal(SIGINT, sighandler);
+    signal(SIGWINCH, sighandler);
+
+    return true;
+}
+
+/* Make the matrix while vlock waits for the screen saver timeout, in the
+ * zygote the child is cloned from.  It only needs the size of the screen. */
+void vlock_prepare(void)
+{
+    struct winsize win;
+
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &win) == -1 || win.ws_row == 0
+        || win.ws_col == 0)
+        return;
+
+    LINES = win.ws_row;
+    COLS = win.ws_col;
+
+    prng_init(&rng, "cmatrix");
+
+    if (!var_init())
+        return;
+
+    prepared_lines = LINES;
+    prepared_cols = COLS;
+}
+
 bool vlock_save(void **ctx_ptr)
 {
+    /* The saver only gets CPU time nobody else wants unless configured
+     * otherwise. */
+    static struct resource_policy policy = {
+        .sched = RESOURCE_SCHED_IDLE,
+    };
     static struct child_process cmatrix_proc = {
         .function = cmatrix_main,
         .argument = NULL,
         .stdin_fd = REDIRECT_DEV_NULL,
         .stdout_fd = NO_REDIRECT,
         .stderr_fd = NO_REDIRECT,
+        .policy = &policy,
+        .zygote_safe = true,
     };
 
-    initscr();
-    savetty();
-    nonl();
-    cbreak();
-    noecho();
-    timeout(0);
-    leaveok(stdscr, TRUE);
-    curs_set(0);
-    signal(SIGINT, sighandler);
-    signal(SIGWINCH, sighandler);
-
     GError *tmp_error = NULL;
 
-    if (!create_child(&cmatrix_proc, &tmp_error))
+    /* Wake the saver that was suspended on the last key press, if it is
+     * still there.  It repaints the whole screen when continued. */
+    if (cmatrix_proc.pid > 0) {
+        (void) screen_begin();
+
+        if (supervisor_resume(cmatrix_proc.pid)) {
+            *ctx_ptr = &cmatrix_proc;
+            return true;
+        }
+    }
+
+    if (!init_screen())
+        return false;
+
+    resource_policy_from_env("cmatrix", &policy);
+
+    if (!supervisor_spawn("cmatrix", &cmatrix_proc, true, &tmp_error))
         return false;
 
     *ctx_ptr = &cmatrix_proc;
@@ -99,14 +154,11 @@ vlock_save_abort(void **ctx_ptr)
 
     if (train_proc != NULL)
     {
-        ensure_death(train_proc->pid);
+        /* Keep the child for a quick resume on the next vlock_save. */
+        supervisor_suspend(train_proc->pid);
 
-        /* Restore sane terminal and uninitialize ncurses. */
-        curs_set(1);
-        clear();
-        refresh();
-        resetty();
-        endwin();
+        /* Restore sane terminal and suspend ncurses. */
+        screen_suspend();
 
         *ctx_ptr = NULL;
     }
@@ -115,109 +167,36 @@ vlock_save_abort(void **ctx_ptr)
 }
 
 
-void *nmalloc(size_t howmuch) {
-    void *r;
-
-    r = malloc(howmuch);
-
-    return r;
-}
-
-/* Vivid colors used for per-stream rainbow coloring.  Black is omitted (it
- * maps to the default pair and would not read as a distinct color) and white
- * is reserved for the bright stream head. */
-static const int rainbow_colors[] = {
+/* Vivid colors used for per-stream rainbow coloring, see MATRIX_COLORS.
+ * Black is omitted (it maps to the default pair and would not read as a
+ * distinct color) and white is reserved for the bright stream head. */
+static const int rainbow_colors[MATRIX_COLORS] = {
     COLOR_GREEN, COLOR_RED, COLOR_BLUE, COLOR_YELLOW, COLOR_CYAN, COLOR_MAGENTA,
 };
 
-static int random_rainbow_color(void) {
-    return rainbow_colors[rand() % (int)(sizeof rainbow_colors / sizeof rainbow_colors[0])];
-}
-
 /* Initialize the global variables */
-void var_init(void) {
-    int i, j;
-
-    /* Guard against degenerate terminal sizes.  Several places below compute
-     * rand() % (LINES - 3), which divides by zero (SIGFPE) or goes negative
-     * when the terminal has fewer than 4 rows.  resize_screen() clamps too,
+bool var_init(void) {
+    /* Guard against degenerate terminal sizes.  matrix_init() draws
+     * stream lengths below LINES - 3, which is zero or negative when the
+     * terminal has fewer than 4 rows.  resize_screen() clamps too,
      * but the very first var_init() runs before any resize. */
     if (LINES < 10)
         LINES = 10;
     if (COLS < 10)
         COLS = 10;
 
-    if (matrix != NULL) {
-        free(matrix[0]);
-        free(matrix);
-    }
-
-    matrix = nmalloc(sizeof(cmatrix *) * (LINES + 1));
-    matrix[0] = nmalloc(sizeof(cmatrix) * (LINES + 1) * COLS);
-    for (i = 1; i <= LINES; i++) {
-        matrix[i] = matrix[i - 1] + COLS;
-    }
-
-    if (length != NULL) {
-        free(length);
-    }
-    length = nmalloc(COLS * sizeof(int));
-
-    if (spaces != NULL) {
-        free(spaces);
-    }
-    spaces = nmalloc(COLS* sizeof(int));
-
-    if (updates != NULL) {
-        free(updates);
-    }
-    updates = nmalloc(COLS * sizeof(int));
-
-    if (colors != NULL) {
-        free(colors);
-    }
-    colors = nmalloc(COLS * sizeof(int));
-
-    /* Make the matrix */
-    for (i = 0; i <= LINES; i++) {
-        for (j = 0; j <= COLS - 1; j += 2) {
-            matrix[i][j].val = -1;
-            /* I couldn't quite get how the bold attribute is used in the code,
-             * but it is used uninitialized later on (according to Valgrind and
-             * my manual inspection). I guess the default value should be 0,
-             * as setting it does not change the observable behaviour and shuts
-             * Valgrind up. Also, the code seems to expect a value of 0,
-             * although I'm not quite sure about that.
-             * In any case, there is an uninitialized use,
-             * so some default value should be set here (whatever it is).
-             */
-            matrix[i][j].bold = 0;
-        }
-    }
-
-    for (j = 0; j <= COLS - 1; j += 2) {
-        /* Set up spaces[] array of how many spaces to skip */
-        spaces[j] = (int) rand() % LINES + 1;
-
-        /* And length of the stream */
-        length[j] = (int) rand() % (LINES - 3) + 3;
-
-        /* Sentinel value for creation of new objects */
-        matrix[1][j].val = ' ';
-
-        /* And set updates[] array for update speed. */
-        updates[j] = (int) rand() % 3 + 1;
-
-        /* Each stream starts with its own random rainbow color. */
-        colors[j] = random_rainbow_color();
-    }
-
+    return matrix_init(&matrix, LINES, COLS, console || xwindow, &rng);
 }
 
 void sighandler(int s) {
     signal_status = s;
 }
 
+static void handle_sigcont(int s) {
+    (void) s;
+    repaint = 1;
+}
+
 void resize_screen(void) {
     char *tty;
     int fd = 0;
@@ -256,7 +235,9 @@ void resize_screen(void) {
     if (wresize(stdscr, LINES, COLS) == ERR) {
         return;
     }
-    var_init();
+    if (!var_init()) {
+        exit(1);
+    }
 
     /* Do these because width may have changed... */
     clear();
@@ -287,38 +268,93 @@ static int cmatrix_color(const char *name) {
         return -1;
 }
 
+/* Interpret an environment variable as a boolean (1/y/yes/true/on). */
+static bool env_is_true(const char *name) {
+    const char *v = getenv(name);
+
+    return v != NULL
+        && (strcmp(v, "1") == 0 || strcmp(v, "y") == 0 || strcmp(v, "Y") == 0
+            || strcmp(v, "yes") == 0 || strcmp(v, "true") == 0
+            || strcmp(v, "on") == 0);
+}
+
+/* The glyph and attributes of a cell as a single chtype, so it is drawn
+ * with one addch() and compared with what stdscr already holds instead of
+ * switching the attributes on and off around every character. */
+static chtype cell_char(int val, int head, int stream_color, int bold) {
+    chtype acs = (console || xwindow) ? A_ALTCHARSET : 0;
+    chtype attrs;
+
+    if (val == MATRIX_HEAD || head == 2) {
+        attrs = acs | COLOR_PAIR(COLOR_WHITE) | (bold ? A_BOLD : 0);
+
+        if (val == MATRIX_HEAD) {
+            return ((console || xwindow) ? 183 : '&') | attrs;
+        }
+        return (chtype) val | attrs;
+    }
+
+    if (val == MATRIX_BAR) {
+        return '|' | COLOR_PAIR(stream_color) | (bold ? A_BOLD : 0);
+    }
+
+    attrs = acs | COLOR_PAIR(stream_color);
+    if (bold == 2 || (bold == 1 && val % 2 == 0)) {
+        attrs |= A_BOLD;
+    }
+
+    return (val == MATRIX_BLANK ? ' ' : (chtype) val) | attrs;
+}
+
+/* Draw cell r of stream s on screen line r - top.  The stream's body is its
+ * own color in rainbow mode, otherwise the single configured color. */
+static void draw_cell(int s, int r, int top, int rainbow, int mcolor,
+                      int bold) {
+    int cell = matrix_cell(&matrix, s, r);
+    int stream_color = rainbow ? rainbow_colors[matrix.colors[s]] : mcolor;
+    chtype ch = cell_char(matrix.val[cell], matrix.bold[cell], stream_color,
+                          bold);
+
+    /* Leave cells that still show the right thing alone, so rows where
+     * nothing fell stay untouched and refresh() has nothing to compare or
+     * write there. */
+    if (mvinch(r - top, 2 * s) != ch) {
+        mvaddch(r - top, 2 * s, ch);
+    }
+}
+
 int cmatrix_main(void *argument) {
 
     // int i, y, z, optchr, keypress;
-    int i, y, z, keypress;
+    int i, y, z, n, keypress;
     int j = 0;
     int count = 0;
     int screensaver = 0;
     int asynch = 0;
     int bold = -1;
     int force = 0;
-    int firstcoldone = 0;
     int oldstyle = 0;
-    int random = 0;
     int update = 4;
-    int highnum = 0;
     int mcolor = COLOR_GREEN;
     int rainbow = 0;    
-    int randnum = 0;
-    int randmin = 0;
     int pause = 0;
-
-    time_t t;
-    srand((unsigned) time(&t));
+    int redraw = 1;     /* the next frame draws every cell */
+    struct frame_clock clock;
 
     // supress compiler warning for now
     (void)argument;
 
+    if (stdscr == NULL && !init_screen())
+        return 1;
+
+    signal(SIGCONT, handle_sigcont);
+
     /* Color and bold come from the JSON config / environment, since the getopt
      * parsing below is disabled in the vlock port.  For the color, the special
      * value "rainbow" gives each stream its own color; an unset or unrecognized
      * color leaves the green default in place.  Bold is 0 (off), 1 (partial) or
-     * 2 (all); anything else leaves the default (off). */
+     * 2 (all); anything else leaves the default (off).  Async lets every
+     * stream fall at its own speed. */
     {
         const char *cfg_color = getenv("VLOCK_CMATRIX_COLOR");
         const char *cfg_bold = getenv("VLOCK_CMATRIX_BOLD");
@@ -335,6 +371,9 @@ int cmatrix_main(void *argument) {
         if (cfg_bold != NULL && cfg_bold[1] == '\0'
             && cfg_bold[0] >= '0' && cfg_bold[0] <= '2')
             bold = cfg_bold[0] - '0';
+
+        if (env_is_true("VLOCK_CMATRIX_ASYNC"))
+            asynch = 1;
     }
 
     /* Many thanks to morph- (morph@jmss.com) for this getopt patch */
@@ -453,20 +492,22 @@ int cmatrix_main(void *argument) {
         }
     }
 
-    srand(time(NULL));
-
-    /* Set up values for random number generation */
-    if (console || xwindow) {
-        randnum = 51;
-        randmin = 166;
-        highnum = 217;
-    } else {
-        randnum = 93;
-        randmin = 33;
-        highnum = 123;
+    /* Unless the screen changed size since vlock_prepare(). */
+    if (LINES != prepared_lines || COLS != prepared_cols) {
+        prng_init(&rng, "cmatrix");
+
+        if (!var_init()) {
+            return 1;
+        }
     }
 
-    var_init();
+    /* Children cloned from the zygote all got the same generator with the
+     * matrix, so each one seeds its own to not replay the others. */
+    prng_init(&rng, "cmatrix");
+    matrix.oldstyle = oldstyle;
+
+    /* One frame every update * 10 milliseconds by default. */
+    frame_clock_init(&clock, "cmatrix", update > 0 ? 100 / update : 1000);
 
     while (1) {
         /* Check for signals */
@@ -479,6 +520,13 @@ int cmatrix_main(void *argument) {
         if (signal_status == SIGWINCH) {
             resize_screen();
             signal_status = 0;
+            redraw = 1;
+        }
+
+        if (repaint) {
+            /* The screen was used for the password prompt. */
+            repaint = 0;
+            clearok(curscr, TRUE);
         }
 
         count++;
@@ -519,6 +567,8 @@ int cmatrix_main(void *argument) {
                 case '8': /* Fall through */
                 case '9':
                     update = keypress - 48;
+                    frame_clock_init(&clock, "cmatrix",
+                                     update > 0 ? 100 / update : 1000);
                     break;
                 case '!':
                     mcolor = COLOR_RED;
@@ -557,192 +607,56 @@ int cmatrix_main(void *argument) {
                     break;
 
                 }
+                redraw = 1;
             }
         }
-        for (j = 0; j <= COLS - 1; j += 2) {
-            if ((count > updates[j] || asynch == 0) && pause == 0) {
-
-                /* I dont like old-style scrolling, yuck */
-                if (oldstyle) {
-                    for (i = LINES - 1; i >= 1; i--) {
-                        matrix[i][j].val = matrix[i - 1][j].val;
-                    }
-                    random = (int) rand() % (randnum + 8) + randmin;
-
-                    if (matrix[1][j].val == 0) {
-                        matrix[0][j].val = 1;
-                    } else if (matrix[1][j].val == ' '
-                             || matrix[1][j].val == -1) {
-                        if (spaces[j] > 0) {
-                            matrix[0][j].val = ' ';
-                            spaces[j]--;
-                        } else {
-
-                            /* Random number to determine whether head of next collumn
-                               of chars has a white 'head' on it. */
-
-                            if (((int) rand() % 3) == 1) {
-                                matrix[0][j].val = 0;
-                            } else {
-                                matrix[0][j].val = (int) rand() % randnum + randmin;
-                            }
-                            spaces[j] = (int) rand() % LINES + 1;
-                        }
-                    } else if (random > highnum && matrix[1][j].val != 1) {
-                        matrix[0][j].val = ' ';
-                    } else {
-                        matrix[0][j].val = (int) rand() % randnum + randmin;
-                    }
-
-                } else { /* New style scrolling (default) */
-                    if (matrix[0][j].val == -1 && matrix[1][j].val == ' '
-                        && spaces[j] > 0) {
-                        matrix[0][j].val = -1;
-                        spaces[j]--;
-                    } else if (matrix[0][j].val == -1
-                        && matrix[1][j].val == ' ') {
-                        length[j] = (int) rand() % (LINES - 3) + 3;
-                        matrix[0][j].val = (int) rand() % randnum + randmin;
-
-                        if ((int) rand() % 2 == 1) {
-                            matrix[0][j].bold = 2;
-                        }
-
-                        spaces[j] = (int) rand() % LINES + 1;
-
-                        /* New stream in this column: give it a new color. */
-                        colors[j] = random_rainbow_color();
-                    }
-                    i = 0;
-                    y = 0;
-                    firstcoldone = 0;
-                    while (i <= LINES) {
-
-                        /* Skip over spaces */
-                        while (i <= LINES && (matrix[i][j].val == ' ' ||
-                               matrix[i][j].val == -1)) {
-                            i++;
-                        }
-
-                        if (i > LINES) {
-                            break;
-                        }
-
-                        /* Go to the head of this collumn */
-                        z = i;
-                        y = 0;
-                        while (i <= LINES && (matrix[i][j].val != ' ' &&
-                               matrix[i][j].val != -1)) {
-                            i++;
-                            y++;
-                        }
-
-                        if (i > LINES) {
-                            matrix[z][j].val = ' ';
-                            matrix[LINES][j].bold = 1;
-                            continue;
-                        }
-
-                        matrix[i][j].val = (int) rand() % randnum + randmin;
-
-                        if (matrix[i - 1][j].bold == 2) {
-                            matrix[i - 1][j].bold = 1;
-                            matrix[i][j].bold = 2;
-                        }
-
-                        /* If we're at the top of the collumn and it's reached its
-                           full length (about to start moving down), we do this
-                           to get it moving.  This is also how we keep segments not
-                           already growing from growing accidentally =>
-                         */
-                        if (y > length[j] || firstcoldone) {
-                            matrix[z][j].val = ' ';
-                            matrix[0][j].val = -1;
-                        }
-                        firstcoldone = 1;
-                        i++;
-                    }
+        if (pause == 0) {
+            matrix.asynch = asynch;
+            matrix_step(&matrix, count);
+        }
+        frame_clock_updated(&clock);
+
+        /* A simple hack */
+        if (!oldstyle) {
+            y = 1;
+            z = LINES;
+        } else {
+            y = 0;
+            z = LINES - 1;
+        }
+
+        /* Draw what the step changed, or everything if the cells on the
+         * screen cannot be trusted. */
+        if (info_box_damaged() || redraw || matrix.all_changed) {
+            redraw = 0;
+
+            for (j = 0; j < matrix.streams; j++) {
+                for (i = y; i <= z; i++) {
+                    draw_cell(j, i, y, rainbow, mcolor, bold);
                 }
             }
-            /* A simple hack */
-            if (!oldstyle) {
-                y = 1;
-                z = LINES;
-            } else {
-                y = 0;
-                z = LINES - 1;
+        } else {
+            for (n = 0; n < matrix.nchanged; n++) {
+                j = matrix.changed[n] / matrix.rows;
+                i = matrix.changed[n] % matrix.rows;
+
+                if (i >= y && i <= z) {
+                    draw_cell(j, i, y, rainbow, mcolor, bold);
+                }
             }
-            /* The stream's body color: its own color in rainbow mode,
-             * otherwise the single configured color.  Constant down the
-             * column so the whole stream stays one color as it falls. */
-            int stream_color = rainbow ? colors[j] : mcolor;
-
-            for (i = y; i <= z; i++) {
-                move(i - y, j);
-
-                if (matrix[i][j].val == 0 || matrix[i][j].bold == 2) {
-                    if (console || xwindow) {
-                        attron(A_ALTCHARSET);
-                    }
-                    attron(COLOR_PAIR(COLOR_WHITE));
-                    if (bold) {
-                        attron(A_BOLD);
-                    }
-                    if (matrix[i][j].val == 0) {
-                        if (console || xwindow) {
-                            addch(183);
-                        } else { 
-                            addch('&');
-                        }
-                    } else {
-                        addch(matrix[i][j].val);
-                    }
-
-                    attroff(COLOR_PAIR(COLOR_WHITE));
-                    if (bold) {
-                        attroff(A_BOLD);
-                    }
-                    if (console || xwindow) {
-                        attroff(A_ALTCHARSET);
-                    }
-                } else {
-
-                    attron(COLOR_PAIR(stream_color));
-                    if (matrix[i][j].val == 1) {
-                        if (bold) {
-                            attron(A_BOLD);
-                        }
-                        addch('|');
-                        if (bold) {
-                            attroff(A_BOLD);
-                        }
-                    } else {
-                        if (console || xwindow) {
-                            attron(A_ALTCHARSET);
-                        }
-                        if (bold == 2 ||
-                            (bold == 1 && matrix[i][j].val % 2 == 0)) {
-                            attron(A_BOLD);
-                        }
-                        if (matrix[i][j].val == -1) {
-                            addch(' ');
-                        } else {
-                            addch(matrix[i][j].val);
-                        }
-                        if (bold == 2 ||
-                            (bold == 1 && matrix[i][j].val % 2 == 0)) {
-                            attroff(A_BOLD);
-                        }
-                        if (console || xwindow) {
-                            attroff(A_ALTCHARSET);
-                        }
-                    }
-                    attroff(COLOR_PAIR(stream_color));
+
+            /* In rainbow mode a new stream recolors the whole column. */
+            for (n = 0; rainbow && n < matrix.nrecolored; n++) {
+                for (i = y; i <= z; i++) {
+                    draw_cell(matrix.recolored[n], i, y, rainbow, mcolor, bold);
                 }
             }
         }
+
         info_box_draw();
-        napms(update * 10);
+        render_refresh();
+        info_box_done();
+        (void) frame_clock_wait(&clock);
     }
     // finish();
     return 0;
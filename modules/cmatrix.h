@@ -1,12 +1,6 @@
 #ifndef _CMATRIX_H_
 #define _CMATRIX_H_
 
-typedef struct cmatrix {
-    int val;
-    int bold;
-} cmatrix;
-
-
 void sighandler(int s);
 
 
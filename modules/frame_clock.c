@@ -0,0 +1,318 @@
+/* frame_clock.c -- shared frame pacing for vlock screen savers
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include "util.h"
+#include "overlay.h"
+#include "powersave.h"
+#include "telemetry.h"
+#include "bench.h"
+#include "frame_clock.h"
+
+#define NSEC_PER_SEC 1000000000ULL
+
+/* Frame rate floor if none is configured. */
+#define DEFAULT_MIN_FPS 5
+
+/* Bytes the terminal may still have queued when a frame is due. */
+#define DEFAULT_TTY_BUDGET 4096
+
+/* Read a frame rate from VLOCK_<NAME>_<KEY> or VLOCK_<KEY>. */
+static unsigned int fps_from_env(const char *name, const char *key,
+                                 const char *general, unsigned int fallback)
+{
+    const char *value = plugin_getenv(name, key);
+    char *end;
+    unsigned long fps;
+
+    if (value == NULL)
+        value = getenv(general);
+
+    if (value == NULL)
+        return fallback;
+
+    fps = strtoul(value, &end, 10);
+
+    if (*end != '\0' || fps == 0 || fps > 1000)
+        return fallback;
+
+    return fps;
+}
+
+/* Return the number of bytes in the output queue of stdout, or -1 if the
+ * terminal does not tell. */
+static long output_queued(void)
+{
+#ifdef TIOCOUTQ
+    int queued;
+
+    if (ioctl(STDOUT_FILENO, TIOCOUTQ, &queued) == 0)
+        return queued;
+#endif
+
+    return -1;
+}
+
+static void sleep_until(uint64_t time)
+{
+    struct timespec deadline = {
+        .tv_sec = time / NSEC_PER_SEC,
+        .tv_nsec = time % NSEC_PER_SEC,
+    };
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL)
+           == EINTR)
+        ;
+}
+
+/* Update the drain rate from the queue shrinking from before to after
+ * within the given time.  Only a queue that did not run empty shows how fast
+ * the terminal really is. */
+static void measure_drain(struct frame_clock *clock, long before, long after,
+                          uint64_t time)
+{
+    uint64_t rate;
+
+    if (before < 0 || after <= 0 || after >= before || time == 0)
+        return;
+
+    rate = (uint64_t) (before - after) * NSEC_PER_SEC / time;
+
+    if (clock->drain_rate == 0)
+        clock->drain_rate = rate;
+    else
+        clock->drain_rate += ((int64_t) rate - (int64_t) clock->drain_rate) / 4;
+}
+
+/* Read the output budget from VLOCK_<NAME>_TTY_BUDGET or VLOCK_TTY_BUDGET. */
+static long budget_from_env(const char *name)
+{
+    const char *value = plugin_getenv(name, "tty_budget");
+    char *end;
+    long budget;
+
+    if (value == NULL)
+        value = getenv("VLOCK_TTY_BUDGET");
+
+    if (value == NULL)
+        return DEFAULT_TTY_BUDGET;
+
+    budget = strtol(value, &end, 10);
+
+    if (*end != '\0' || budget <= 0)
+        return DEFAULT_TTY_BUDGET;
+
+    return budget;
+}
+
+/* Time spent writing the current frame to the terminal.  There is one
+ * frame clock per process. */
+static uint64_t flush_start;
+static uint64_t flush_total;
+
+void frame_clock_updated(struct frame_clock *clock)
+{
+    clock->updated = monotonic_ns();
+}
+
+void frame_clock_flush_begin(void)
+{
+    flush_start = monotonic_ns();
+    bench_flush_begin();
+}
+
+void frame_clock_flush_end(void)
+{
+    flush_total += monotonic_ns() - flush_start;
+    bench_flush_end();
+}
+
+/* Publish what the frame that just ended cost. */
+static void publish(struct frame_clock *clock, uint64_t now)
+{
+    struct saver_telemetry *t = clock->telemetry;
+    uint64_t cost = now - clock->frame_start;
+    uint64_t update = 0;
+    uint64_t flush = flush_total;
+
+    flush_total = 0;
+
+    if (t == NULL)
+        return;
+
+    if (clock->updated > clock->frame_start)
+        update = clock->updated - clock->frame_start;
+
+    if (flush > cost - update)
+        flush = cost - update;
+
+    t->update_ns += update;
+    t->render_ns += cost - update - flush;
+    t->flush_ns += flush;
+    t->dropped = clock->skipped;
+    t->frames++;
+    telemetry_frame_done(t);
+
+    if (now - clock->sampled >= NSEC_PER_SEC) {
+        telemetry_sample_process(t);
+        clock->sampled = now;
+    }
+}
+
+unsigned int frame_clock_fps(const char *name, unsigned int default_fps)
+{
+    return fps_from_env(name, "fps", "VLOCK_FPS", default_fps);
+}
+
+void frame_clock_init(struct frame_clock *clock, const char *name,
+                      unsigned int default_fps)
+{
+    unsigned int fps = frame_clock_fps(name, default_fps);
+    unsigned int min_fps = fps_from_env(name, "min_fps", "VLOCK_MIN_FPS",
+                                        DEFAULT_MIN_FPS);
+
+    if (min_fps > fps)
+        min_fps = fps;
+
+    clock->target_period = NSEC_PER_SEC / fps;
+    clock->max_period = NSEC_PER_SEC / min_fps;
+    clock->period = clock->target_period;
+    clock->cost = 0;
+    clock->frames = 0;
+    clock->skipped = 0;
+    clock->next = monotonic_ns();
+    clock->frame_start = clock->next;
+    clock->queued = output_queued();
+    clock->drain_rate = 0;
+    clock->budget = budget_from_env(name);
+    clock->telemetry = telemetry_find(name);
+    clock->updated = 0;
+    clock->sampled = 0;
+    flush_total = 0;
+
+    telemetry_attach(clock->telemetry);
+
+    (void) bench_start(name);
+}
+
+/* Lower the frame rate if frames take most of their interval, and raise it
+ * again once they take less than a quarter. */
+static void adapt(struct frame_clock *clock)
+{
+    if (clock->cost > clock->period - clock->period / 8) {
+        clock->period += clock->period / 4;
+
+        if (clock->period > clock->max_period)
+            clock->period = clock->max_period;
+    } else if (clock->cost < clock->period / 4
+               && clock->period > clock->target_period) {
+        clock->period -= clock->period / 5;
+
+        if (clock->period < clock->target_period)
+            clock->period = clock->target_period;
+    }
+}
+
+unsigned int frame_clock_wait(struct frame_clock *clock)
+{
+    uint64_t now = monotonic_ns();
+    uint64_t cost = now - clock->frame_start;
+    unsigned int elapsed = 1;
+    uint64_t period;
+    unsigned int max_fps;
+    long queued;
+
+    publish(clock, now);
+
+    /* Benchmarks render frames back to back. */
+    if (bench_enabled()) {
+        bench_frame_done();
+        clock->frames++;
+        return 1;
+    }
+
+    queued = output_queued();
+
+    /* A frame is only done once the terminal has shown it. */
+    if (queued > clock->queued && clock->queued >= 0 && clock->drain_rate > 0) {
+        uint64_t drain = (uint64_t) (queued - clock->queued) * NSEC_PER_SEC
+                         / clock->drain_rate;
+
+        if (drain > cost)
+            cost = drain;
+    }
+
+    /* Exponential moving average over about eight frames. */
+    if (clock->frames++ == 0)
+        clock->cost = cost;
+    else
+        clock->cost += ((int64_t) cost - (int64_t) clock->cost) / 8;
+
+    adapt(clock);
+
+    period = clock->period;
+    /* Read once, vlock-main may reset it to 0 at any time. */
+    max_fps = powersave_max_fps();
+
+    /* Slow down behind the password prompt. */
+    if (overlay_active() && period < NSEC_PER_SEC / overlay_get()->fps)
+        period = NSEC_PER_SEC / overlay_get()->fps;
+    /* ... and when the saver was left alone for long (src/powersave.c). */
+    else if (max_fps > 0 && period < NSEC_PER_SEC / max_fps)
+        period = NSEC_PER_SEC / max_fps;
+
+    clock->next += period;
+
+    if (now >= clock->next) {
+        /* Late: drop the frames that were missed instead of rendering them
+         * back to back. */
+        uint64_t missed = (now - clock->next) / period + 1;
+
+        clock->next += missed * period;
+        clock->skipped += missed;
+        elapsed += missed;
+    }
+
+    sleep_until(clock->next);
+
+    if (queued >= 0) {
+        uint64_t woken = monotonic_ns();
+        long left = output_queued();
+
+        measure_drain(clock, queued, left, woken - now);
+
+        /* Skip frames until the terminal has caught up. */
+        while (left > clock->budget) {
+            clock->next += period;
+            clock->skipped++;
+            elapsed++;
+
+            sleep_until(clock->next);
+            now = woken;
+            woken = monotonic_ns();
+            queued = left;
+            left = output_queued();
+            measure_drain(clock, queued, left, woken - now);
+        }
+
+        clock->queued = left;
+    }
+
+    clock->frame_start = monotonic_ns();
+
+    return elapsed;
+}
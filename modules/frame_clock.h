@@ -0,0 +1,82 @@
+/* frame_clock.h -- shared frame pacing for vlock screen savers
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+struct saver_telemetry;
+
+struct frame_clock
+{
+    uint64_t period;            /* current frame interval in nanoseconds */
+    uint64_t target_period;     /* interval at the configured frame rate */
+    uint64_t max_period;        /* interval at the frame rate floor */
+    uint64_t next;              /* absolute deadline of the next frame */
+    uint64_t frame_start;       /* when the current frame began rendering */
+    uint64_t cost;              /* smoothed render time of a frame */
+    unsigned long frames;
+    unsigned long skipped;
+    long budget;                /* bytes the terminal may lag behind */
+    long queued;                /* tty output queue when the frame began,
+                                   -1 if unknown */
+    uint64_t drain_rate;        /* bytes per second the tty drains, 0 if
+                                   not measured yet */
+    struct saver_telemetry *telemetry;  /* see src/telemetry.h, NULL if
+                                           vlock-main does not track the
+                                           saver */
+    uint64_t updated;           /* when the current frame's update step
+                                   ended, see frame_clock_updated() */
+    uint64_t sampled;           /* when the process was last sampled for
+                                   the telemetry */
+};
+
+/* Return the frame rate of the saver with the given name, from
+ * VLOCK_<NAME>_FPS or VLOCK_FPS, or default_fps if neither is set. */
+unsigned int frame_clock_fps(const char *name, unsigned int default_fps);
+
+/* Set up the clock for the saver with the given name.  The frame rate is
+ * taken from VLOCK_<NAME>_FPS or VLOCK_FPS, falling back to default_fps, and
+ * the floor from VLOCK_<NAME>_MIN_FPS or VLOCK_MIN_FPS.  The output budget in
+ * bytes comes from VLOCK_<NAME>_TTY_BUDGET or VLOCK_TTY_BUDGET.  The first
+ * frame is due immediately. */
+void frame_clock_init(struct frame_clock *clock, const char *name,
+                      unsigned int default_fps);
+
+/* Optionally called when the animation has advanced and drawing the frame
+ * begins, to tell update and render time apart in the telemetry that is
+ * published to vlock-main.  Without it both count as render time. */
+void frame_clock_updated(struct frame_clock *clock);
+
+/* Put around the code that writes a frame to the terminal, so the time is
+ * accounted as flush time.  Also used by benchmark mode (see bench.h). */
+void frame_clock_flush_begin(void);
+void frame_clock_flush_end(void);
+
+/* Call after a frame was drawn.  Sleeps until the next frame is due on an
+ * absolute CLOCK_MONOTONIC deadline, so the time spent rendering is not added
+ * to the interval.  Returns how many frame intervals have passed since the
+ * last call: 1 normally, more if rendering fell behind and frames were
+ * skipped.  Savers may advance their animation by that many steps.
+ *
+ * If rendering takes most of the interval the frame rate is lowered step by
+ * step down to the floor, and raised back to the target once frames are
+ * cheap again, so a slow terminal gets fewer frames instead of a saver that
+ * never sleeps.
+ *
+ * On terminals that report their output queue (TIOCOUTQ on stdout, e.g. a
+ * pty or a serial line) frames are also skipped while more than the budget
+ * is still queued.  The time the terminal needs to drain a frame counts as
+ * part of its cost, so a slow line lowers the frame rate as well.
+ *
+ * In benchmark mode (see bench.h) it does not sleep at all. */
+unsigned int frame_clock_wait(struct frame_clock *clock);
@@ -14,8 +14,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 #include <ncurses.h>
 
+#include "overlay.h"
+#include "prng.h"
 #include "info_box.h"
 
 /* Color pair used for the box; chosen above the range the savers use. */
@@ -28,6 +31,17 @@ static chtype box_attr;         /* white-on-black pair, or A_REVERSE fallback */
 static int box_x = -1;          /* current top-left; < 0 until first placement */
 static int box_y = -1;
 static time_t last_move = 0;
+static struct prng rng;
+
+/* Overlay generation the saver last drew for, and whether the cursor of the
+ * password prompt was saved before the current frame. */
+static unsigned int seen_generation = 0;
+static int saved_cursor = 0;
+
+/* What info_box_damaged() reports: whether the box moved since it was last
+ * asked, and the overlay generation it was last asked for. */
+static int moved = 0;
+static unsigned int damage_generation = 0;
 
 /* Human-readable wake-key name, mirroring vlock-main's VLOCK_WAKE_KEY values. */
 static const char *wake_key_name(void)
@@ -57,6 +71,7 @@ static void info_box_init(void)
         return;
 
     snprintf(message, sizeof message, "Press %s key to wake.", wake_key_name());
+    prng_init(&rng, "info_box");
 
     /* Prefer a real white-on-black pair so the box has a solid black
      * background; fall back to reverse video if color is unavailable. */
@@ -85,14 +100,48 @@ static void clear_rect(int x, int y, int w, int h)
     }
 }
 
-void info_box_draw(void)
+/* Keep the frame off the rows of the password prompt while it is shown over
+ * the saver, and repaint them once it is gone.  The prompt is written by
+ * vlock-main behind ncurses' back, so its rows are set to what ncurses
+ * believes is on the screen, which makes the refresh skip them. */
+static void protect_prompt(void)
+{
+    const struct overlay *overlay = overlay_get();
+    unsigned int generation;
+    int top, rows;
+
+    if (overlay == NULL)
+        return;
+
+    generation = overlay->generation;
+    top = overlay->top;
+    rows = overlay->rows;
+
+    if (top < 0 || top >= LINES)
+        return;
+
+    if (top + rows > LINES)
+        rows = LINES - top;
+
+    if (generation % 2 == 1) {
+        for (int r = top; r < top + rows; r++)
+            copywin(curscr, stdscr, r, 0, r, 0, r, COLS - 1, FALSE);
+
+        /* Drawing moves the cursor away from where the prompt is typed. */
+        if (write(STDOUT_FILENO, "\0337", 2) == 2)
+            saved_cursor = 1;
+    } else if (generation != seen_generation) {
+        wredrawln(stdscr, top, rows);
+    }
+
+    seen_generation = generation;
+}
+
+static void draw_box(void)
 {
     int bw, bh;
     time_t now;
 
-    if (!initialized)
-        info_box_init();
-
     if (interval <= 0)
         return;
 
@@ -107,11 +156,13 @@ void info_box_draw(void)
 
     if (box_x < 0 || (now - last_move) >= interval) {
         /* Erase the old footprint before relocating. */
-        if (box_x >= 0)
+        if (box_x >= 0) {
             clear_rect(box_x, box_y, bw, bh);
+            moved = 1;
+        }
 
-        box_x = rand() % (COLS - bw + 1);
-        box_y = rand() % (LINES - bh + 1);
+        box_x = prng_below(&rng, COLS - bw + 1);
+        box_y = prng_below(&rng, LINES - bh + 1);
         last_move = now;
     }
 
@@ -138,3 +189,35 @@ void info_box_draw(void)
 
     attroff(box_attr);
 }
+
+void info_box_draw(void)
+{
+    if (!initialized)
+        info_box_init();
+
+    draw_box();
+    protect_prompt();
+}
+
+bool info_box_damaged(void)
+{
+    const struct overlay *overlay = overlay_get();
+    bool damaged = moved;
+
+    moved = 0;
+
+    if (overlay != NULL && overlay->generation != damage_generation) {
+        damage_generation = overlay->generation;
+        damaged = true;
+    }
+
+    return damaged;
+}
+
+void info_box_done(void)
+{
+    if (saved_cursor) {
+        saved_cursor = 0;
+        (void) write(STDOUT_FILENO, "\0338", 2);
+    }
+}
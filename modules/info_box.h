@@ -12,6 +12,8 @@
 
 #pragma once
 
+#include <stdbool.h>
+
 /* Draw the info box over the current ncurses frame, if enabled.  Enabled and
  * configured through the environment: VLOCK_INFO_BOX is the move interval in
  * seconds (0 or unset disables it) and VLOCK_WAKE_KEY names the wake key shown
@@ -20,3 +22,15 @@
  * its own content and before the frame is refreshed.  ncurses must already be
  * initialized. */
 void info_box_draw(void);
+
+/* Return true if cells the saver drew were overwritten since the last call:
+ * the box moved away from them, or the password prompt was shown or hidden
+ * over the saver.  For savers that only draw the cells that changed, which
+ * should redraw all of them then.  Call before drawing a frame. */
+bool info_box_damaged(void);
+
+/* While the password prompt is shown over the saver (see general.prompt_overlay)
+ * info_box_draw() also keeps the frame off the prompt's rows and saves the
+ * prompt's cursor position.  Call this after the frame was refreshed to put the
+ * cursor back. */
+void info_box_done(void);
@@ -0,0 +1,338 @@
+/* matrix.c -- the falling streams of the cmatrix screen saver for vlock
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* The rules are those of cmatrix by Chris Allegretta and Abishek V Ashok,
+ * and the numbers are drawn in the same order, so a seed gives the same
+ * picture as before the state was split out of cmatrix.c. */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "matrix.h"
+
+/* The per-stream arrays are allocated for a multiple of this many streams,
+ * so the compiler can handle a whole block at once without a loop for the
+ * streams left over. */
+#define BLOCK 16
+
+/* matrix_step() flags of a stream: a new stream starts at its top. */
+#define SPAWN 1
+
+static bool is_gap(int val)
+{
+    return val == MATRIX_SPACE || val == MATRIX_BLANK;
+}
+
+static int16_t random_glyph(struct matrix *m)
+{
+    return (int16_t) (prng_below(m->rng, m->randnum) + m->randmin);
+}
+
+/* The most cells matrix_step() can change in a stream: the top when a new
+ * stream starts, every stream's head, the cell above a white head, its last
+ * cell, and the top once more, for at most (rows + 1) / 2 streams. */
+static int max_changes(int rows)
+{
+    return 2 * rows + 4;
+}
+
+void matrix_free(struct matrix *m)
+{
+    free(m->val);
+    free(m->bold);
+    free(m->length);
+    free(m->spaces);
+    free(m->updates);
+    free(m->colors);
+    free(m->flags);
+    free(m->top_free);
+    free(m->wheel);
+    free(m->changed);
+    free(m->recolored);
+
+    m->val = NULL;
+    m->bold = NULL;
+    m->length = NULL;
+    m->spaces = NULL;
+    m->updates = NULL;
+    m->colors = NULL;
+    m->flags = NULL;
+    m->top_free = NULL;
+    m->wheel = NULL;
+    m->changed = NULL;
+    m->recolored = NULL;
+}
+
+bool matrix_init(struct matrix *m, int lines, int cols, bool console,
+                 struct prng *rng)
+{
+    int cells, blocks;
+
+    matrix_free(m);
+
+    m->lines = lines;
+    m->rows = lines + 1;
+    m->streams = (cols + 1) / 2;
+    m->rng = rng;
+    m->nchanged = 0;
+    m->nrecolored = 0;
+    m->all_changed = true;
+
+    if (console) {
+        m->randnum = 51;
+        m->randmin = 166;
+        m->highnum = 217;
+    } else {
+        m->randnum = 93;
+        m->randmin = 33;
+        m->highnum = 123;
+    }
+
+    cells = m->streams * m->rows;
+    blocks = (m->streams + BLOCK - 1) / BLOCK;
+
+    m->val = malloc(cells * sizeof *m->val);
+    m->bold = calloc(cells, sizeof *m->bold);
+    m->length = calloc(blocks * BLOCK, sizeof *m->length);
+    m->spaces = calloc(blocks * BLOCK, sizeof *m->spaces);
+    m->updates = calloc(blocks * BLOCK, sizeof *m->updates);
+    m->colors = calloc(blocks * BLOCK, sizeof *m->colors);
+    m->flags = calloc(blocks * BLOCK, sizeof *m->flags);
+    m->top_free = calloc(blocks * BLOCK, sizeof *m->top_free);
+    m->wheel = malloc(m->streams * MATRIX_TICKS * sizeof *m->wheel);
+    m->changed = malloc(m->streams * max_changes(m->rows)
+                        * sizeof *m->changed);
+    m->recolored = malloc(m->streams * sizeof *m->recolored);
+
+    if (m->val == NULL || m->bold == NULL || m->length == NULL
+        || m->spaces == NULL || m->updates == NULL || m->colors == NULL
+        || m->flags == NULL || m->top_free == NULL || m->wheel == NULL
+        || m->changed == NULL || m->recolored == NULL) {
+        matrix_free(m);
+        return false;
+    }
+
+    for (int i = 0; i < cells; i++)
+        m->val[i] = MATRIX_BLANK;
+
+    for (int s = 0; s < m->streams; s++) {
+        /* How many frames to wait before the first stream. */
+        m->spaces[s] = (int) prng_below(rng, lines) + 1;
+        m->length[s] = (int) prng_below(rng, lines - 3) + 3;
+
+        /* Sentinel value for creation of new objects */
+        m->val[matrix_cell(m, s, 1)] = MATRIX_SPACE;
+        m->top_free[s] = 1;
+
+        m->updates[s] = (int) prng_below(rng, MATRIX_TICKS - 1) + 1;
+        m->colors[s] = (int) prng_below(rng, MATRIX_COLORS);
+    }
+
+    /* The speeds never change, so every turn of the wheel is the same.  A
+     * stream is in the slot of every count above its updates, and the
+     * slots keep the order of the streams. */
+    for (int tick = 0, n = 0; tick < MATRIX_TICKS; tick++) {
+        m->slots[tick] = n;
+
+        for (int s = 0; s < m->streams; s++)
+            if (tick + 1 > m->updates[s])
+                m->wheel[n++] = s;
+
+        m->slots[tick + 1] = n;
+    }
+
+    return true;
+}
+
+/* Start a new stream at the top of the column. */
+static void spawn(struct matrix *m, int s)
+{
+    int top = matrix_cell(m, s, 0);
+
+    m->length[s] = (int) prng_below(m->rng, m->lines - 3) + 3;
+    m->val[top] = random_glyph(m);
+
+    if (prng_below(m->rng, 2) == 1)
+        m->bold[top] = 2;
+
+    m->spaces[s] = (int) prng_below(m->rng, m->lines) + 1;
+    m->colors[s] = (int) prng_below(m->rng, MATRIX_COLORS);
+
+    m->changed[m->nchanged++] = top;
+    m->recolored[m->nrecolored++] = s;
+}
+
+/* Move every stream in the column down by one cell: a new glyph below its
+ * head, and its last cell cleared once it is long enough.  The streams
+ * further down have all stopped growing. */
+static void advance(struct matrix *m, int s)
+{
+    int base = matrix_cell(m, s, 0);
+    int16_t *val = m->val + base;
+    uint8_t *bold = m->bold + base;
+    int32_t *changed = m->changed + m->nchanged;
+    int lines = m->lines;
+    int limit = m->length[s];
+    bool first = true;
+    int i = 0;
+
+    while (i <= lines) {
+        int tail;
+
+        while (i <= lines && is_gap(val[i]))
+            i++;
+
+        if (i > lines)
+            break;
+
+        tail = i;
+
+        while (i <= lines && !is_gap(val[i]))
+            i++;
+
+        /* Runs off the bottom of the screen. */
+        if (i > lines) {
+            val[tail] = MATRIX_SPACE;
+            *changed++ = base + tail;
+
+            if (bold[lines] != 1) {
+                bold[lines] = 1;
+                *changed++ = base + lines;
+            }
+
+            break;
+        }
+
+        val[i] = random_glyph(m);
+        *changed++ = base + i;
+
+        if (bold[i - 1] == 2) {
+            bold[i - 1] = 1;
+            bold[i] = 2;
+            *changed++ = base + i - 1;
+        }
+
+        if (i - tail > limit || !first) {
+            val[tail] = MATRIX_SPACE;
+            *changed++ = base + tail;
+
+            if (val[0] != MATRIX_BLANK) {
+                val[0] = MATRIX_BLANK;
+                *changed++ = base;
+            }
+        }
+
+        first = false;
+        i++;
+    }
+
+    m->nchanged = changed - m->changed;
+}
+
+/* Old-style scrolling: the whole column moves down and a new cell is made
+ * at the top. */
+static void scroll(struct matrix *m, int s)
+{
+    int16_t *val = m->val + matrix_cell(m, s, 0);
+    int random;
+
+    memmove(val + 1, val, (m->lines - 1) * sizeof *val);
+    random = (int) prng_below(m->rng, m->randnum + 8) + m->randmin;
+
+    if (val[1] == MATRIX_HEAD) {
+        val[0] = MATRIX_BAR;
+    } else if (is_gap(val[1])) {
+        if (m->spaces[s] > 0) {
+            val[0] = MATRIX_SPACE;
+            m->spaces[s]--;
+        } else {
+            /* Whether the next stream gets a white head. */
+            if (prng_below(m->rng, 3) == 1)
+                val[0] = MATRIX_HEAD;
+            else
+                val[0] = random_glyph(m);
+
+            m->spaces[s] = (int) prng_below(m->rng, m->lines) + 1;
+        }
+    } else if (random > m->highnum && val[1] != MATRIX_BAR) {
+        val[0] = MATRIX_SPACE;
+    } else {
+        val[0] = random_glyph(m);
+    }
+}
+
+/* Count down the frames until the next stream starts in the column of a
+ * stream that moves.  Returns its flags. */
+static inline uint8_t countdown(int newstyle, uint8_t top_free,
+                                int32_t *spaces)
+{
+    int idle = newstyle & top_free;
+    int wait = idle & (*spaces > 0);
+
+    *spaces -= wait;
+
+    return (uint8_t) (idle & !wait);
+}
+
+/* The countdown for all streams, when they all move.  No branches and no
+ * random numbers, so the compiler does this for several streams at once. */
+static void pick(int blocks, int newstyle, const uint8_t *restrict top_free,
+                 int32_t *restrict spaces, uint8_t *restrict flags)
+{
+    for (int b = 0; b < blocks * BLOCK; b += BLOCK)
+        for (int s = b; s < b + BLOCK; s++)
+            flags[s] = countdown(newstyle, top_free[s], &spaces[s]);
+}
+
+static void move(struct matrix *m, int s, uint8_t flags)
+{
+    const int16_t *top = m->val + matrix_cell(m, s, 0);
+
+    if (m->oldstyle) {
+        scroll(m, s);
+    } else {
+        if (flags & SPAWN)
+            spawn(m, s);
+
+        advance(m, s);
+    }
+
+    m->top_free[s] = top[0] == MATRIX_BLANK && top[1] == MATRIX_SPACE;
+}
+
+void matrix_step(struct matrix *m, int count)
+{
+    int newstyle = !m->oldstyle;
+
+    m->nchanged = 0;
+    m->nrecolored = 0;
+    m->all_changed = m->oldstyle;
+
+    /* The numbers are drawn stream after stream. */
+    if (m->asynch) {
+        int tick = count < 1 ? 0 : count > MATRIX_TICKS ? MATRIX_TICKS - 1
+                                                        : count - 1;
+
+        /* Only the streams in the slot of the wheel are looked at. */
+        for (int i = m->slots[tick]; i < m->slots[tick + 1]; i++) {
+            int s = m->wheel[i];
+
+            move(m, s, countdown(newstyle, m->top_free[s], &m->spaces[s]));
+        }
+    } else {
+        pick((m->streams + BLOCK - 1) / BLOCK, newstyle, m->top_free,
+             m->spaces, m->flags);
+
+        for (int s = 0; s < m->streams; s++)
+            move(m, s, m->flags[s]);
+    }
+}
@@ -0,0 +1,102 @@
+/* matrix.h -- the falling streams of the cmatrix screen saver for vlock
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "prng.h"
+
+/* The simulation behind cmatrix, without any drawing.  There is a stream on
+ * every second screen column.  Every stream has lines + 1 cells, the first
+ * one above the screen, and they are stored stream after stream, so cell r
+ * of stream s is at index s * rows + r.  A cell holds a glyph or one of
+ * MATRIX_BLANK, MATRIX_SPACE, MATRIX_HEAD and MATRIX_BAR.  The per-stream
+ * state is kept in arrays of its own, so the countdown of all streams runs
+ * over packed integers. */
+#define MATRIX_BLANK -1         /* nothing was ever drawn here */
+#define MATRIX_SPACE ' '        /* a stream has passed */
+#define MATRIX_HEAD 0           /* the white head of old-style streams */
+#define MATRIX_BAR 1            /* the cell above an old-style head */
+
+/* Streams get one of this many colors in rainbow mode. */
+#define MATRIX_COLORS 6
+
+/* matrix_step()'s count runs from 1 to this.  With asynch, a stream moves
+ * when count is above its updates, which is from 1 to MATRIX_TICKS - 1. */
+#define MATRIX_TICKS 4
+
+struct matrix
+{
+    int lines;                  /* lines on the screen */
+    int rows;                   /* cells per stream, lines + 1 */
+    int streams;
+
+    /* Glyphs are drawn from randmin to randmin + randnum - 1.  Old-style
+     * streams break off above highnum. */
+    int randnum;
+    int randmin;
+    int highnum;
+
+    /* Set by the caller: streams move at their own speed, and old-style
+     * scrolling moves whole columns instead of the streams in them. */
+    bool asynch;
+    bool oldstyle;
+
+    int16_t *val;               /* streams * rows cells */
+    uint8_t *bold;              /* 2 marks a white head, see matrix_step() */
+
+    int32_t *length;            /* length a new stream grows to */
+    int32_t *spaces;            /* frames until the next stream starts */
+    int32_t *updates;           /* frames between moves with asynch */
+    int32_t *colors;            /* rainbow color, below MATRIX_COLORS */
+    uint8_t *flags;             /* what matrix_step() does to the stream */
+    uint8_t *top_free;          /* whether the top two cells are free, so a
+                                   new stream can start */
+
+    /* The streams that move with asynch, as a timing wheel with a slot per
+     * count: wheel[slots[count - 1]] up to wheel[slots[count]] in order. */
+    int32_t *wheel;
+    int slots[MATRIX_TICKS + 1];
+
+    /* What the last matrix_step() changed: the indexes of the cells, in no
+     * particular order and possibly more than once, and the streams that
+     * got a new color.  all_changed is set instead when the list would not
+     * tell much, e.g. after old-style scrolling. */
+    int32_t *changed;
+    int nchanged;
+    int32_t *recolored;
+    int nrecolored;
+    bool all_changed;
+
+    struct prng *rng;
+};
+
+/* Make empty streams for a screen of the given size, drawing their speeds,
+ * lengths and colors from rng, which must stay around.  Glyphs come from
+ * the Latin-1 range if console is set, from ASCII otherwise.  Returns false
+ * if out of memory. */
+bool matrix_init(struct matrix *m, int lines, int cols, bool console,
+                 struct prng *rng);
+
+void matrix_free(struct matrix *m);
+
+/* Move the streams one frame.  count runs from 1 to MATRIX_TICKS and picks
+ * the streams that move with asynch.  Those that do not move are not looked
+ * at. */
+void matrix_step(struct matrix *m, int count);
+
+static inline int matrix_cell(const struct matrix *m, int s, int r)
+{
+    return s * m->rows + r;
+}
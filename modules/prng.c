@@ -0,0 +1,149 @@
+/* prng.c -- random numbers for vlock screen savers
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* rand() takes a lock on every call and its state is shared by everything
+ * in the process.  The savers draw several numbers per column and frame, so
+ * each has its own generator that makes them in batches instead. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "prng.h"
+
+static uint64_t splitmix64(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+    return z ^ (z >> 31);
+}
+
+bool prng_env_seed(uint64_t *seed)
+{
+    const char *value = getenv("VLOCK_SEED");
+    char *end;
+
+    if (value == NULL || *value == '\0')
+        return false;
+
+    *seed = strtoull(value, &end, 10);
+
+    return *end == '\0';
+}
+
+void prng_seed(struct prng *rng, uint64_t seed)
+{
+    for (int i = 0; i < 4; i++)
+        for (int lane = 0; lane < PRNG_LANES; lane++)
+            rng->s[i][lane] = splitmix64(&seed);
+
+    rng->used = PRNG_BATCH;
+}
+
+void prng_init(struct prng *rng, const char *name)
+{
+    uint64_t seed;
+
+    if (!prng_env_seed(&seed))
+        seed = (uint64_t) time(NULL) << 20 ^ (uint64_t) getpid();
+
+    /* FNV-1a of the name. */
+    for (const char *c = name; *c != '\0'; c++)
+        seed = (seed ^ (unsigned char) *c) * 0x100000001b3ULL;
+
+    prng_seed(rng, seed);
+}
+
+#if defined(__GNUC__) && PRNG_LANES == 4
+typedef uint64_t lanes __attribute__((vector_size(PRNG_LANES * 8)));
+
+#define ROTL(x, k) (((x) << (k)) | ((x) >> (64 - (k))))
+
+/* Step all lanes at once, making PRNG_LANES * 2 numbers per step. */
+static void generate(struct prng *rng, uint32_t *out, size_t steps)
+{
+    lanes s0, s1, s2, s3;
+
+    memcpy(&s0, rng->s[0], sizeof s0);
+    memcpy(&s1, rng->s[1], sizeof s1);
+    memcpy(&s2, rng->s[2], sizeof s2);
+    memcpy(&s3, rng->s[3], sizeof s3);
+
+    for (size_t i = 0; i < steps; i++) {
+        lanes x = s1 * 5;
+        lanes result = ROTL(x, 7) * 9;
+        lanes t = s1 << 17;
+
+        s2 ^= s0;
+        s3 ^= s1;
+        s1 ^= s2;
+        s0 ^= s3;
+        s2 ^= t;
+        s3 = ROTL(s3, 45);
+
+        memcpy(out + i * PRNG_LANES * 2, &result, sizeof result);
+    }
+
+    memcpy(rng->s[0], &s0, sizeof s0);
+    memcpy(rng->s[1], &s1, sizeof s1);
+    memcpy(rng->s[2], &s2, sizeof s2);
+    memcpy(rng->s[3], &s3, sizeof s3);
+}
+#else
+static uint64_t rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+static void generate(struct prng *rng, uint32_t *out, size_t steps)
+{
+    for (size_t i = 0; i < steps; i++) {
+        for (int lane = 0; lane < PRNG_LANES; lane++) {
+            uint64_t *s0 = &rng->s[0][lane], *s1 = &rng->s[1][lane];
+            uint64_t *s2 = &rng->s[2][lane], *s3 = &rng->s[3][lane];
+            uint64_t result = rotl(*s1 * 5, 7) * 9;
+            uint64_t t = *s1 << 17;
+
+            *s2 ^= *s0;
+            *s3 ^= *s1;
+            *s1 ^= *s2;
+            *s0 ^= *s3;
+            *s2 ^= t;
+            *s3 = rotl(*s3, 45);
+
+            memcpy(out + (i * PRNG_LANES + lane) * 2, &result, sizeof result);
+        }
+    }
+}
+#endif
+
+void prng_refill(struct prng *rng)
+{
+    generate(rng, rng->batch, PRNG_BATCH / (PRNG_LANES * 2));
+    rng->used = 0;
+}
+
+void prng_fill(struct prng *rng, uint32_t *out, size_t n)
+{
+    size_t steps = n / (PRNG_LANES * 2);
+
+    /* Whole steps go straight into the array, the rest comes from the
+     * batch. */
+    generate(rng, out, steps);
+
+    for (size_t i = steps * PRNG_LANES * 2; i < n; i++)
+        out[i] = prng_next(rng);
+}
@@ -0,0 +1,61 @@
+/* prng.h -- random numbers for vlock screen savers
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Independent xoshiro256** generators stepped side by side, so a whole
+ * batch of numbers is made at once (with SIMD where the compiler supports
+ * vector extensions).  Numbers are handed out from the batch. */
+#define PRNG_LANES 4
+#define PRNG_BATCH 64
+
+struct prng
+{
+    uint64_t s[4][PRNG_LANES];
+    uint32_t batch[PRNG_BATCH];
+    unsigned int used;
+};
+
+/* The seed in VLOCK_SEED, if set.  Returns false otherwise. */
+bool prng_env_seed(uint64_t *seed);
+
+/* Seed the generator of the given user (e.g. a saver's name) from
+ * VLOCK_SEED, so runs can be repeated, or from the time and pid otherwise.
+ * Different users get different sequences from the same seed. */
+void prng_init(struct prng *rng, const char *name);
+
+void prng_seed(struct prng *rng, uint64_t seed);
+
+/* Refill the batch.  Only called by the functions below. */
+void prng_refill(struct prng *rng);
+
+static inline uint32_t prng_next(struct prng *rng)
+{
+    if (rng->used == PRNG_BATCH)
+        prng_refill(rng);
+
+    return rng->batch[rng->used++];
+}
+
+/* Return a number from 0 to bound - 1, or 0 if bound is 0.  The bias of the
+ * multiply and shift is below bound / 2^32. */
+static inline uint32_t prng_below(struct prng *rng, uint32_t bound)
+{
+    return (uint32_t) (((uint64_t) prng_next(rng) * bound) >> 32);
+}
+
+/* Fill the array with n numbers. */
+void prng_fill(struct prng *rng, uint32_t *out, size_t n);
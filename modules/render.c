@@ -0,0 +1,248 @@
+/* render.c -- frame output for vlock screen savers
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ncurses.h>
+
+#include "overlay.h"
+#include "vcsa.h"
+#include "frame_clock.h"
+#include "render.h"
+
+static enum { UNTRIED, VCSA, NCURSES } backend = UNTRIED;
+static struct vcsa *vcsa = NULL;
+
+/* Font positions of the characters drawn so far, without and with
+ * A_ALTCHARSET; -1 if not looked up yet. */
+static short glyphs[2][256];
+
+/* Overlay generation seen by the last frame. */
+static unsigned int seen_generation = 0;
+
+static int value_is_false(const char *value)
+{
+    return strcmp(value, "0") == 0 || strcmp(value, "n") == 0
+        || strcmp(value, "no") == 0 || strcmp(value, "false") == 0
+        || strcmp(value, "off") == 0;
+}
+
+/* A path in VLOCK_VCSA is only followed without privileges.  vlock-main
+ * ignores it and uses the screen buffer of its console, so it cannot be made
+ * to write into an arbitrary file. */
+static void render_init(void)
+{
+    const char *value = getenv("VLOCK_VCSA");
+
+    backend = NCURSES;
+
+    if (value == NULL || strcmp(value, "auto") == 0)
+        vcsa = vcsa_open_console();
+    else if (value[0] == '/' && getuid() == geteuid() && getgid() == getegid())
+        vcsa = vcsa_open(value, STDOUT_FILENO);
+    else if (!value_is_false(value))
+        vcsa = vcsa_open_console();
+
+    if (vcsa == NULL)
+        return;
+
+    memset(glyphs, -1, sizeof glyphs);
+    backend = VCSA;
+}
+
+/* The Unicode character of the given character of the alternate character
+ * set, see the acsc capability in terminfo(5). */
+static unsigned int acs_unicode(unsigned int c)
+{
+    switch (c) {
+    case 'q': return 0x2500;
+    case 'x': return 0x2502;
+    case 'l': return 0x250c;
+    case 'k': return 0x2510;
+    case 'm': return 0x2514;
+    case 'j': return 0x2518;
+    case 't': return 0x251c;
+    case 'u': return 0x2524;
+    case 'w': return 0x252c;
+    case 'v': return 0x2534;
+    case 'n': return 0x253c;
+    case 'o': case 'p': case 'r': case 's': return 0x2500;
+    case '0': return 0x2588;
+    case 'a': return 0x2592;
+    case 'h': return 0x2591;
+    case '`': return 0x25c6;
+    case '~': return 0x00b7;
+    case 'f': return 0x00b0;
+    case 'g': return 0x00b1;
+    case ',': return 0x2190;
+    case '-': return 0x2191;
+    case '+': return 0x2192;
+    case '.': return 0x2193;
+    case 'y': return 0x2264;
+    case 'z': return 0x2265;
+    case '{': return 0x03c0;
+    case '|': return 0x2260;
+    case '}': return 0x00a3;
+    default: return c;
+    }
+}
+
+static unsigned char cell_glyph(chtype ch)
+{
+    unsigned int c = ch & 0xff;
+    int alt = (ch & A_ALTCHARSET) != 0;
+
+    if (glyphs[alt][c] < 0)
+        glyphs[alt][c] = vcsa_glyph(vcsa, alt ? acs_unicode(c) : c);
+
+    return glyphs[alt][c];
+}
+
+/* Map a curses color to the console's palette, which has blue and red
+ * swapped.  Colors of 256 color terminals are reduced to the nearest of the
+ * 16. */
+static unsigned char vga_color(short color, unsigned char fallback)
+{
+    static const unsigned char vga[8] = { 0, 4, 2, 6, 1, 5, 3, 7 };
+
+    if (color < 0)
+        return fallback;
+    else if (color < 8)
+        return vga[color];
+    else if (color < 16)
+        return vga[color - 8] | 8;
+    else if (color < 232) {
+        int r = (color - 16) / 36, g = (color - 16) / 6 % 6, b = (color - 16) % 6;
+        int max = r > g ? (r > b ? r : b) : (g > b ? g : b);
+        unsigned char c = (r >= 3 ? 4 : 0) | (g >= 3 ? 2 : 0) | (b >= 3 ? 1 : 0);
+
+        if (c == 0)
+            return max >= 2 ? 8 : 0;
+
+        return max >= 5 ? c | 8 : c;
+    } else {
+        int level = color - 232;
+
+        return level < 6 ? 0 : level < 12 ? 8 : level < 18 ? 7 : 15;
+    }
+}
+
+static unsigned char cell_attr(chtype ch)
+{
+    short fg = -1, bg = -1;
+    unsigned char vga_fg, vga_bg, tmp;
+
+    (void) pair_content(PAIR_NUMBER(ch), &fg, &bg);
+
+    vga_fg = vga_color(fg, 7);
+    vga_bg = vga_color(bg, 0);
+
+    if (ch & A_REVERSE) {
+        tmp = vga_fg;
+        vga_fg = vga_bg;
+        vga_bg = tmp;
+    }
+
+    if (ch & A_BOLD)
+        vga_fg |= 8;
+
+    /* The bit picks the upper half of a 512 glyph font instead, where the
+     * glyphs looked up are not. */
+    if (!vcsa_bright(vcsa))
+        vga_fg &= 7;
+
+    return (ch & A_BLINK ? 0x80 : 0) | (vga_bg & 7) << 4 | vga_fg;
+}
+
+void render_refresh(void)
+{
+    const struct overlay *overlay = overlay_get();
+    int skip_top = LINES, skip_bottom = LINES;
+    int rows, cols, cury, curx;
+    chtype last_attrs = 0;
+    unsigned char attr = 0;
+    bool flushed;
+
+    if (backend == UNTRIED)
+        render_init();
+
+    if (backend != VCSA) {
+        frame_clock_flush_begin();
+        refresh();
+        frame_clock_flush_end();
+        return;
+    }
+
+    if (vcsa_sync_size(vcsa) || is_cleared(curscr) || is_cleared(stdscr)) {
+        vcsa_invalidate(vcsa);
+        clearok(curscr, FALSE);
+        clearok(stdscr, FALSE);
+    }
+
+    /* Leave the rows of the password prompt alone while it is shown over
+     * the saver, and repaint them once it is gone. */
+    if (overlay != NULL) {
+        unsigned int generation = overlay->generation;
+
+        if (generation % 2 == 1) {
+            skip_top = overlay->top;
+            skip_bottom = overlay->top + overlay->rows;
+        } else if (generation != seen_generation) {
+            vcsa_invalidate(vcsa);
+        }
+
+        seen_generation = generation;
+    }
+
+    rows = LINES < vcsa_rows(vcsa) ? LINES : vcsa_rows(vcsa);
+    cols = COLS < vcsa_cols(vcsa) ? COLS : vcsa_cols(vcsa);
+
+    getyx(stdscr, cury, curx);
+
+    for (int y = 0; y < rows; y++) {
+        if (y >= skip_top && y < skip_bottom)
+            continue;
+
+        for (int x = 0; x < cols; x++) {
+            chtype ch = mvwinch(stdscr, y, x);
+
+            /* Neighbouring cells mostly share their attributes. */
+            if ((ch & A_ATTRIBUTES) != last_attrs || (y == 0 && x == 0)) {
+                last_attrs = ch & A_ATTRIBUTES;
+                attr = cell_attr(ch);
+            }
+
+            vcsa_put(vcsa, y, x, cell_glyph(ch), attr);
+        }
+    }
+
+    wmove(stdscr, cury, curx);
+
+    frame_clock_flush_begin();
+    flushed = vcsa_flush(vcsa) >= 0;
+    frame_clock_flush_end();
+
+    if (!flushed) {
+        vcsa_close(vcsa);
+        vcsa = NULL;
+        backend = NCURSES;
+        clearok(curscr, TRUE);
+        refresh();
+        return;
+    }
+
+    /* The screen is up to date, so a wgetch() on stdscr must not refresh it
+     * through ncurses again. */
+    untouchwin(stdscr);
+    wnoutrefresh(stdscr);
+}
@@ -0,0 +1,32 @@
+/* render.h -- frame output for vlock screen savers
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#pragma once
+
+/* Show stdscr like refresh() does.  On a Linux virtual console the cells
+ * that changed are written straight into its screen buffer (/dev/vcsaN, see
+ * vcsa.h) instead, so neither ncurses nor the kernel deal with escape
+ * sequences.  VLOCK_VCSA selects the backend: unset or "auto" uses the screen
+ * buffer when there is one, a false value always uses ncurses and a path
+ * names a file with the layout of a screen buffer to write to.  The path is
+ * ignored by a process with privileges, i.e. vlock-main, which uses the
+ * screen buffer of its console instead.  Falls back to refresh() for good if
+ * the screen buffer cannot be written.
+ *
+ * /dev/vcsaN usually belongs to root and group tty, so savers running in a
+ * child process without privileges cannot open it and use ncurses; only
+ * those drawn through vlock_tick in vlock-main write the screen buffer.
+ *
+ * Savers that call clearok(curscr, TRUE) to repaint the whole screen get a
+ * full write of the screen buffer as well.  ncurses must already be
+ * initialized. */
+void render_refresh(void);
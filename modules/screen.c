@@ -0,0 +1,56 @@
+/* screen.c -- shared ncurses screen for vlock screen savers
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* Every saver module links its own copy of this file, but ncurses' screen
+ * belongs to the process.  So whether it exists and whether it is suspended
+ * is asked of ncurses (stdscr, isendwin()) instead of being tracked here. */
+
+#include <stdio.h>
+#include <ncurses.h>
+
+#include "screen.h"
+
+bool screen_begin(void)
+{
+    if (stdscr == NULL) {
+        /* Unlike initscr(), newterm() does not exit the process if the
+         * terminal is unusable. */
+        if (newterm(NULL, stdout, stdin) == NULL)
+            return false;
+
+        savetty();
+        nonl();
+        cbreak();
+        noecho();
+        timeout(0);
+        leaveok(stdscr, TRUE);
+    } else if (isendwin()) {
+        reset_prog_mode();
+        clearok(curscr, TRUE);
+    }
+
+    curs_set(0);
+
+    return true;
+}
+
+void screen_suspend(void)
+{
+    if (stdscr == NULL || isendwin())
+        return;
+
+    curs_set(1);
+    clear();
+    refresh();
+    resetty();
+    endwin();
+}
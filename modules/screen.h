@@ -0,0 +1,28 @@
+/* screen.h -- shared ncurses screen for vlock screen savers
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+/* Get the screen ready for a saver to draw on.  The first call in a process
+ * creates it with newterm() on stdout and puts the terminal into the mode
+ * the savers draw in: no echo, no newline translation, no line buffering,
+ * non-blocking input and no cursor.  Later calls only resume it after
+ * screen_suspend(), and the next refresh repaints everything.  The screen is
+ * shared by all savers of a process.  Returns false if the terminal cannot
+ * be used. */
+bool screen_begin(void);
+
+/* Clear the screen, give the terminal back in the mode it was found in and
+ * suspend ncurses until the next screen_begin(). */
+void screen_suspend(void);
@@ -35,9 +35,14 @@
 #include <ncurses.h>
 
 #include "process.h"
+#include "supervisor.h"
 #include "vlock_plugin.h"
 #include "train.h"
 #include "info_box.h"
+#include "render.h"
+#include "screen.h"
+#include "frame_clock.h"
+#include "prng.h"
 
 void add_smoke(int y, int x);
 void add_man(int y, int x);
@@ -54,11 +59,22 @@ int C51       = 0;
 
 /* Random value chosen once per pass to vary the train's vertical position. */
 static int train_rnd = 0;
+static struct prng rng;
+
 /* Whether vertical randomization is enabled (set from VLOCK_TRAIN_RANDOM). */
 static int train_random = 0;
 
+/* Set when the child is continued after being suspended. */
+static volatile sig_atomic_t repaint = 0;
+
 static int train_main(void *argument);
 
+static void handle_sigcont(int signum)
+{
+    (void)signum;
+    repaint = 1;
+}
+
 /* Interpret an environment variable as a boolean (1/y/yes/true/on). */
 static bool env_is_true(const char *name)
 {
@@ -70,29 +86,52 @@ static bool env_is_true(const char *name)
             || strcmp(v, "on") == 0);
 }
 
+/* Initialize ncurses, in vlock-main and in a child started by the zygote. */
+static bool init_screen(void)
+{
+    if (!screen_begin())
+        return false;
+
+    signal(SIGINT, SIG_IGN);
+    scrollok(stdscr, FALSE);
+
+    return true;
+}
+
 bool vlock_save(void **ctx_ptr)
 {
+    static struct resource_policy policy = {
+        .sched = RESOURCE_SCHED_IDLE,
+    };
     static struct child_process train_proc = {
         .function = train_main,
         .argument = NULL,
         .stdin_fd = REDIRECT_DEV_NULL,
         .stdout_fd = NO_REDIRECT,
         .stderr_fd = NO_REDIRECT,
+        .policy = &policy,
+        .zygote_safe = true,
     };
 
-    /* Initialize ncurses. */
-    initscr();
-    signal(SIGINT, SIG_IGN);
-    noecho();
-    curs_set(0);
-    nodelay(stdscr, TRUE);
-    leaveok(stdscr, TRUE);
-    scrollok(stdscr, FALSE);
+    GError *tmp_error = NULL;
 
+    /* Wake the train that was suspended on the last key press, if it is
+     * still there.  It repaints the whole screen when continued. */
+    if (train_proc.pid > 0) {
+        (void) screen_begin();
 
-    GError *tmp_error = NULL;
+        if (supervisor_resume(train_proc.pid)) {
+            *ctx_ptr = &train_proc;
+            return true;
+        }
+    }
 
-    if (!create_child(&train_proc, &tmp_error))
+    if (!init_screen())
+        return false;
+
+    resource_policy_from_env("train", &policy);
+
+    if (!supervisor_spawn("train", &train_proc, true, &tmp_error))
         return false;
 
     *ctx_ptr = &train_proc;
@@ -107,12 +146,11 @@ vlock_save_abort(void **ctx_ptr)
 
     if (train_proc != NULL)
     {
-        ensure_death(train_proc->pid);
+        /* Keep the child for a quick resume on the next vlock_save. */
+        supervisor_suspend(train_proc->pid);
 
-        /* Restore sane terminal and uninitialize ncurses. */
-        curs_set(1);
-        refresh();
-        endwin();
+        /* Restore sane terminal and suspend ncurses. */
+        screen_suspend();
         *ctx_ptr = NULL;
     }
 
@@ -122,23 +160,31 @@ vlock_save_abort(void **ctx_ptr)
 static int
 train_main(void *argument)
 {
+    struct frame_clock clock;
     int x;
 
     (void)argument;
 
+    if (stdscr == NULL && !init_screen())
+        return 1;
+
+    signal(SIGCONT, handle_sigcont);
+
     /* Vertical-position randomization is opt-in via the VLOCK_TRAIN_RANDOM
      * environment variable (config key modules.train.random). */
     train_random = env_is_true("VLOCK_TRAIN_RANDOM");
 
     if (train_random)
-        srand((unsigned) time(NULL));
+        prng_init(&rng, "train");
+
+    frame_clock_init(&clock, "train", 50);
 
     do
     {
         if (train_random) {
             /* New random vertical position each pass; clear the screen so the
              * previous pass (at a different height) leaves no trail. */
-            train_rnd = rand();
+            train_rnd = (int) (prng_next(&rng) >> 1);
             erase();
         }
 
@@ -154,8 +200,18 @@ train_main(void *argument)
             }
             getch();
             info_box_draw();
-            refresh();
-            usleep(20000);
+
+            if (repaint) {
+                /* The screen was used for the password prompt. */
+                repaint = 0;
+                clearok(curscr, TRUE);
+            }
+
+            render_refresh();
+            info_box_done();
+            /* Move on by one column per frame interval, even if frames
+             * had to be skipped. */
+            x -= frame_clock_wait(&clock) - 1;
         }
         mvcur(0, COLS - 1, LINES - 1, 0);
 
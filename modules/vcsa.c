@@ -0,0 +1,401 @@
+/* vcsa.c -- direct Linux console screen buffer output for vlock screen savers
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#if !defined(__FreeBSD__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/sysmacros.h>
+#include <linux/kd.h>
+#include <linux/major.h>
+#endif
+
+#include "vcsa.h"
+
+#define HEADER_SIZE 4
+
+/* Unchanged cells between two changed ones that are written anyway to save
+ * a pwrite(). */
+#define MERGE_GAP 4
+
+struct glyph_map
+{
+    unsigned int unicode;
+    unsigned short glyph;
+};
+
+struct vcsa
+{
+    int fd;
+    int rows;
+    int cols;
+    /* Glyph and attribute pairs, in the layout of the file. */
+    unsigned char *next;
+    unsigned char *shown;
+    bool shown_valid;
+    /* The console font's Unicode map sorted by character, NULL if unknown. */
+    struct glyph_map *map;
+    size_t map_size;
+    /* The font has more than 256 glyphs. */
+    bool font_512;
+};
+
+/* The characters of code page 437 that the savers may draw beyond ASCII,
+ * used when the console font cannot be asked. */
+static const struct glyph_map cp437[] = {
+    { 0x00a3, 0x9c }, { 0x00b0, 0xf8 }, { 0x00b1, 0xf1 }, { 0x00b7, 0xfa },
+    { 0x03c0, 0xe3 }, { 0x2022, 0x07 }, { 0x2190, 0x1b }, { 0x2191, 0x18 },
+    { 0x2192, 0x1a }, { 0x2193, 0x19 }, { 0x2260, 0xd8 }, { 0x2264, 0xf3 },
+    { 0x2265, 0xf2 }, { 0x2500, 0xc4 }, { 0x2502, 0xb3 }, { 0x250c, 0xda },
+    { 0x2510, 0xbf }, { 0x2514, 0xc0 }, { 0x2518, 0xd9 }, { 0x251c, 0xc3 },
+    { 0x2524, 0xb4 }, { 0x252c, 0xc2 }, { 0x2534, 0xc1 }, { 0x253c, 0xc5 },
+    { 0x2588, 0xdb }, { 0x2591, 0xb0 }, { 0x2592, 0xb1 }, { 0x25c6, 0x04 },
+};
+
+static int compare_glyph_map(const void *a, const void *b)
+{
+    const struct glyph_map *x = a;
+    const struct glyph_map *y = b;
+
+    return x->unicode < y->unicode ? -1 : x->unicode > y->unicode;
+}
+
+bool vcsa_set_font_map(struct vcsa *vcsa, const unsigned int *unicode,
+                       const unsigned short *glyph, size_t n)
+{
+    struct glyph_map *map = calloc(n ? n : 1, sizeof *map);
+
+    if (map == NULL)
+        return false;
+
+    for (size_t i = 0; i < n; i++) {
+        map[i].unicode = unicode[i];
+        map[i].glyph = glyph[i];
+
+        if (glyph[i] >= 256)
+            vcsa->font_512 = true;
+    }
+
+    qsort(map, n, sizeof *map, compare_glyph_map);
+
+    free(vcsa->map);
+    vcsa->map = map;
+    vcsa->map_size = n;
+
+    return true;
+}
+
+/* Load the Unicode map of the font of the console on the given descriptor. */
+static void load_font_map(struct vcsa *vcsa, int tty_fd)
+{
+#ifdef GIO_UNIMAP
+    struct unimapdesc desc = { 0, NULL };
+
+    if (tty_fd < 0)
+        return;
+
+#ifdef KD_FONT_OP_GET
+    {
+        /* Without a buffer only the size of the font is returned. */
+        struct console_font_op op = { .op = KD_FONT_OP_GET };
+
+        if (ioctl(tty_fd, KDFONTOP, &op) == 0 && op.charcount > 256)
+            vcsa->font_512 = true;
+    }
+#endif
+
+    /* The first call only tells how many entries there are. */
+    if (ioctl(tty_fd, GIO_UNIMAP, &desc) < 0 && errno != ENOMEM)
+        return;
+
+    if (desc.entry_ct == 0)
+        return;
+
+    desc.entries = calloc(desc.entry_ct, sizeof *desc.entries);
+
+    if (desc.entries == NULL)
+        return;
+
+    if (ioctl(tty_fd, GIO_UNIMAP, &desc) == 0) {
+        unsigned int *unicode = calloc(desc.entry_ct, sizeof *unicode);
+        unsigned short *glyph = calloc(desc.entry_ct, sizeof *glyph);
+
+        if (unicode != NULL && glyph != NULL) {
+            for (size_t i = 0; i < desc.entry_ct; i++) {
+                unicode[i] = desc.entries[i].unicode;
+                glyph[i] = desc.entries[i].fontpos;
+            }
+
+            (void) vcsa_set_font_map(vcsa, unicode, glyph, desc.entry_ct);
+        }
+
+        free(unicode);
+        free(glyph);
+    }
+
+    free(desc.entries);
+#else
+    (void) vcsa;
+    (void) tty_fd;
+#endif
+}
+
+static bool read_size(struct vcsa *vcsa, int *rows, int *cols)
+{
+    unsigned char header[HEADER_SIZE];
+    ssize_t n = pread(vcsa->fd, header, sizeof header, 0);
+
+    if (n != sizeof header) {
+        if (n >= 0)
+            errno = EINVAL;
+
+        return false;
+    }
+
+    *rows = header[0];
+    *cols = header[1];
+
+    return true;
+}
+
+static bool resize(struct vcsa *vcsa, int rows, int cols)
+{
+    size_t size = (size_t) rows * cols * 2;
+    unsigned char *next = calloc(size ? size : 1, 1);
+    unsigned char *shown = calloc(size ? size : 1, 1);
+
+    if (next == NULL || shown == NULL) {
+        free(next);
+        free(shown);
+        return false;
+    }
+
+    free(vcsa->next);
+    free(vcsa->shown);
+
+    vcsa->next = next;
+    vcsa->shown = shown;
+    vcsa->rows = rows;
+    vcsa->cols = cols;
+    vcsa->shown_valid = false;
+
+    return true;
+}
+
+struct vcsa *vcsa_open(const char *path, int tty_fd)
+{
+    struct vcsa *vcsa = calloc(1, sizeof *vcsa);
+    int rows, cols;
+
+    if (vcsa == NULL)
+        return NULL;
+
+    vcsa->fd = open(path, O_RDWR | O_CLOEXEC);
+
+    if (vcsa->fd < 0 || !read_size(vcsa, &rows, &cols)
+        || !resize(vcsa, rows, cols)) {
+        int errsv = errno;
+
+        vcsa_close(vcsa);
+        errno = errsv;
+        return NULL;
+    }
+
+    load_font_map(vcsa, tty_fd);
+
+    return vcsa;
+}
+
+struct vcsa *vcsa_open_console(void)
+{
+#if defined(__linux__) && defined(TTY_MAJOR) && defined(VCS_MAJOR)
+    struct vcsa *vcsa;
+    struct stat st;
+    char path[32];
+
+    if (fstat(STDOUT_FILENO, &st) < 0)
+        return NULL;
+
+    /* /dev/tty1 to /dev/tty63 are the virtual consoles. */
+    if (!S_ISCHR(st.st_mode) || major(st.st_rdev) != TTY_MAJOR
+        || minor(st.st_rdev) < 1 || minor(st.st_rdev) > 63) {
+        errno = ENOTTY;
+        return NULL;
+    }
+
+    (void) snprintf(path, sizeof path, "/dev/vcsa%u", minor(st.st_rdev));
+
+    vcsa = vcsa_open(path, STDOUT_FILENO);
+
+    if (vcsa == NULL)
+        return NULL;
+
+    /* Only ever write to a console's screen buffer. */
+    if (fstat(vcsa->fd, &st) < 0 || !S_ISCHR(st.st_mode)
+        || major(st.st_rdev) != VCS_MAJOR) {
+        vcsa_close(vcsa);
+        errno = ENODEV;
+        return NULL;
+    }
+
+    return vcsa;
+#else
+    errno = ENOTTY;
+    return NULL;
+#endif
+}
+
+void vcsa_close(struct vcsa *vcsa)
+{
+    if (vcsa == NULL)
+        return;
+
+    if (vcsa->fd >= 0)
+        (void) close(vcsa->fd);
+
+    free(vcsa->next);
+    free(vcsa->shown);
+    free(vcsa->map);
+    free(vcsa);
+}
+
+int vcsa_rows(const struct vcsa *vcsa)
+{
+    return vcsa->rows;
+}
+
+int vcsa_cols(const struct vcsa *vcsa)
+{
+    return vcsa->cols;
+}
+
+bool vcsa_sync_size(struct vcsa *vcsa)
+{
+    int rows, cols;
+
+    if (!read_size(vcsa, &rows, &cols)
+        || (rows == vcsa->rows && cols == vcsa->cols))
+        return false;
+
+    return resize(vcsa, rows, cols);
+}
+
+bool vcsa_bright(const struct vcsa *vcsa)
+{
+    return !vcsa->font_512;
+}
+
+unsigned char vcsa_glyph(const struct vcsa *vcsa, unsigned int unicode)
+{
+    const struct glyph_map key = { unicode, 0 };
+    const struct glyph_map *found;
+
+    if (vcsa->map != NULL) {
+        found = bsearch(&key, vcsa->map, vcsa->map_size, sizeof *vcsa->map,
+                        compare_glyph_map);
+
+        /* Positions above 255 need the attribute's intensity bit. */
+        if (found != NULL && found->glyph < 256)
+            return found->glyph;
+
+        return unicode == '?' ? '?' : vcsa_glyph(vcsa, '?');
+    }
+
+    if (unicode >= 0x20 && unicode < 0x7f)
+        return unicode;
+
+    found = bsearch(&key, cp437, sizeof cp437 / sizeof cp437[0],
+                    sizeof cp437[0], compare_glyph_map);
+
+    return found != NULL ? found->glyph : '?';
+}
+
+void vcsa_put(struct vcsa *vcsa, int y, int x, unsigned char glyph,
+              unsigned char attr)
+{
+    size_t i;
+
+    if (y < 0 || y >= vcsa->rows || x < 0 || x >= vcsa->cols)
+        return;
+
+    i = ((size_t) y * vcsa->cols + x) * 2;
+    vcsa->next[i] = glyph;
+    vcsa->next[i + 1] = attr;
+}
+
+void vcsa_invalidate(struct vcsa *vcsa)
+{
+    vcsa->shown_valid = false;
+}
+
+static bool cell_changed(const struct vcsa *vcsa, size_t cell)
+{
+    return !vcsa->shown_valid
+        || memcmp(vcsa->next + cell * 2, vcsa->shown + cell * 2, 2) != 0;
+}
+
+int vcsa_flush(struct vcsa *vcsa)
+{
+    size_t cells = (size_t) vcsa->rows * vcsa->cols;
+    size_t cell = 0;
+    int writes = 0;
+
+    while (cell < cells) {
+        size_t start, end;
+        ssize_t length, n;
+
+        while (cell < cells && !cell_changed(vcsa, cell))
+            cell++;
+
+        if (cell == cells)
+            break;
+
+        /* Extend the run over short gaps of unchanged cells. */
+        start = cell;
+        end = cell + 1;
+
+        for (cell = end; cell < cells && cell < end + MERGE_GAP; cell++) {
+            if (cell_changed(vcsa, cell))
+                end = cell + 1;
+        }
+
+        cell = end;
+        length = (end - start) * 2;
+
+        n = pwrite(vcsa->fd, vcsa->next + start * 2, length,
+                   HEADER_SIZE + start * 2);
+
+        if (n != length) {
+            if (n >= 0)
+                errno = EIO;
+
+            return -1;
+        }
+
+        memcpy(vcsa->shown + start * 2, vcsa->next + start * 2, length);
+        writes++;
+    }
+
+    vcsa->shown_valid = true;
+
+    return writes;
+}
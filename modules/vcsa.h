@@ -0,0 +1,70 @@
+/* vcsa.h -- direct Linux console screen buffer output for vlock screen savers
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* A /dev/vcsaN screen buffer: a 4 byte header (rows, columns, cursor column
+ * and row) followed by a glyph and an attribute byte per cell.  Cells are
+ * collected with vcsa_put() and only those that changed since the last
+ * vcsa_flush() are written.  Any regular file with the same layout works as
+ * well, which is how the backend is tested without a virtual console. */
+struct vcsa;
+
+/* Open the screen buffer at the given path.  Glyphs are looked up in the
+ * font of the console on tty_fd, or taken from code page 437 if tty_fd is -1
+ * or not a console.  Returns NULL with errno set on failure. */
+struct vcsa *vcsa_open(const char *path, int tty_fd);
+
+/* Open the screen buffer of the virtual console stdout is connected to.
+ * Returns NULL with errno set if stdout is not a virtual console or its
+ * buffer cannot be opened. */
+struct vcsa *vcsa_open_console(void);
+
+void vcsa_close(struct vcsa *vcsa);
+
+int vcsa_rows(const struct vcsa *vcsa);
+int vcsa_cols(const struct vcsa *vcsa);
+
+/* Read the geometry from the header again.  Returns true if it changed, in
+ * which case the whole buffer is written by the next vcsa_flush(). */
+bool vcsa_sync_size(struct vcsa *vcsa);
+
+/* Use the given map from Unicode characters to font positions, as
+ * GIO_UNIMAP reports it, instead of the one of the console font, e.g. for
+ * tests.  Returns false if out of memory. */
+bool vcsa_set_font_map(struct vcsa *vcsa, const unsigned int *unicode,
+                       const unsigned short *glyph, size_t n);
+
+/* Whether the intensity bit of an attribute (8) makes the foreground
+ * bright.  With a font of more than 256 glyphs it selects the upper half of
+ * the font instead, so it has to be left clear. */
+bool vcsa_bright(const struct vcsa *vcsa);
+
+/* Return the font position of the given Unicode character, or that of '?'
+ * if the font has no glyph for it. */
+unsigned char vcsa_glyph(const struct vcsa *vcsa, unsigned int unicode);
+
+/* Set the cell at the given row and column for the next vcsa_flush().  Cells
+ * outside the screen are ignored. */
+void vcsa_put(struct vcsa *vcsa, int y, int x, unsigned char glyph,
+              unsigned char attr);
+
+/* Forget what is on the screen, so the next vcsa_flush() writes every cell,
+ * e.g. after something else drew on it. */
+void vcsa_invalidate(struct vcsa *vcsa);
+
+/* Write the cells that changed since the last flush, one pwrite() per run of
+ * changed cells.  Returns the number of writes or -1 with errno set. */
+int vcsa_flush(struct vcsa *vcsa);
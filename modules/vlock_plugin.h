@@ -11,6 +11,7 @@
  *
  */
 #include <stdbool.h>
+#include <stdint.h>
 
 extern const char *preceeds[];
 extern const char *succeeds[];
@@ -23,3 +24,13 @@ bool vlock_start(void **);
 bool vlock_end(void **);
 bool vlock_save(void **);
 bool vlock_save_abort(void **);
+
+/* Called by vlock-main vlock_tick_hz times per second between vlock_save and
+ * vlock_save_abort, with the value of monotonic_ns(). */
+bool vlock_tick(void **, uint64_t);
+extern unsigned int vlock_tick_hz;
+
+/* Called once when locking starts, before vlock_save, in the process the
+ * saver's children are started from: the zygote if there is one, vlock-main
+ * otherwise.  Must not touch the terminal. */
+void vlock_prepare(void);
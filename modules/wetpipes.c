@@ -22,8 +22,14 @@
 #include <ncurses.h>
 
 #include "process.h"
+#include "supervisor.h"
 #include "vlock_plugin.h"
+#include "util.h"
 #include "info_box.h"
+#include "render.h"
+#include "screen.h"
+#include "frame_clock.h"
+#include "prng.h"
 
 /* ── plugin dependencies ────────────────────────────────────────── */
 
@@ -75,7 +81,7 @@ static const char bubble_glyph[BUBBLE_KIND_COUNT]  = { ':', '.', 'o', '8', 'O' }
 static const int  bubble_period[BUBBLE_KIND_COUNT] = {  3,   2,   4,   5,   7  };
 
 /* delay between consecutive state transitions so the change is
-   readable -- ~500ms at napms(80) is 6-7 frames */
+   readable -- ~500ms at 12 frames per second is 6-7 frames */
 #define TRANSITION_LOCKOUT_FRAMES   6
 
 /* A stream can hold up to one bubble of each color simultaneously
@@ -179,7 +185,36 @@ static volatile sig_atomic_t signal_status = 0;
    cells, then the bubbles are drawn at their new positions on top. */
 static WINDOW              *static_canvas = NULL;
 
+/* animation state shared by the child's loop and vlock_tick */
+static int                  frame = 0;
+static int                  sky_h = 1;
+
+/* whether vlock-main renders the frames through vlock_tick, and
+   whether it has set up the scene already.  The scene is kept between
+   saves so waking the saver again is only a repaint. */
+static bool                 in_process = false;
+static bool                 scene_ready = false;
+
+/* set when the child is continued after being suspended */
+static volatile sig_atomic_t repaint = 0;
+
+/* seeded for the pipes, and again for the bubbles in every child */
+static struct prng          rng;
+
+/* screen size vlock_prepare() laid the pipes out for, 0 if it did not */
+static int                  prepared_lines = 0;
+static int                  prepared_cols = 0;
+
+/* frames per second unless modules.wetpipes.fps says otherwise */
+#define WETPIPES_FPS        12
+
+/* rate of vlock_tick; 0 while a child process renders instead */
+unsigned int vlock_tick_hz = 0;
+
 static int  wetpipes_main(void *argument);
+static void handle_sigcont(int s);
+static void setup_scene(void);
+static void draw_next_frame(struct frame_clock *clock);
 static void sighandler(int s);
 static void init_colors(void);
 static void compute_pipes(void);
@@ -191,54 +226,128 @@ static void resize_screen(void);
 
 /* ── vlock hooks ────────────────────────────────────────────────── */
 
+/* vlock-main sets up the screen before starting the child.  A child
+   started by the zygote has to do it again itself. */
+static bool init_screen(void)
+{
+    if(!screen_begin()) return false;
+
+    signal(SIGINT,   sighandler);
+    signal(SIGWINCH, sighandler);
+    return true;
+}
+
+/* lay the pipes out while vlock waits for the screen saver timeout, in
+   the zygote the child is cloned from.  The canvas needs a screen, so
+   it is still drawn by whoever renders the scene. */
+void vlock_prepare(void)
+{
+    struct winsize win;
+
+    if(ioctl(STDOUT_FILENO, TIOCGWINSZ, &win) == -1
+       || win.ws_row == 0 || win.ws_col == 0) return;
+
+    LINES = win.ws_row < 10 ? 10 : win.ws_row;
+    COLS  = win.ws_col < 10 ? 10 : win.ws_col;
+
+    prng_init(&rng, "wetpipes");
+    compute_pipes();
+
+    prepared_lines = LINES;
+    prepared_cols  = COLS;
+}
+
 bool vlock_save(void **ctx_ptr)
 {
+    static struct resource_policy policy = {
+        .sched = RESOURCE_SCHED_IDLE,
+    };
     static struct child_process wetpipes_proc = {
         .function = wetpipes_main,
         .argument = NULL,
         .stdin_fd = REDIRECT_DEV_NULL,
         .stdout_fd = NO_REDIRECT,
         .stderr_fd = NO_REDIRECT,
+        .policy = &policy,
+        .zygote_safe = true,
     };
     GError *tmp_error = NULL;
+    const char *fork_child = plugin_getenv("wetpipes", "fork");
+
+    /* draw from vlock-main's event loop, so waking up only has to stop
+       the ticks -- unless the scene should be drawn in its own process
+       (modules.wetpipes.fork) */
+    if(fork_child == NULL || (strcmp(fork_child, "1") != 0
+                              && strcmp(fork_child, "true") != 0
+                              && strcmp(fork_child, "yes") != 0))
+    {
+        if(scene_ready)
+        {
+            /* resuming the screen repaints it on the next tick */
+            (void)screen_begin();
+        }
+        else
+        {
+            if(!init_screen()) return false;
+            setup_scene();
+            scene_ready = true;
+        }
 
-    initscr();
-    savetty();
-    nonl();
-    cbreak();
-    noecho();
-    timeout(0);
-    leaveok(stdscr, TRUE);
-    curs_set(0);
-    signal(SIGINT,   sighandler);
-    signal(SIGWINCH, sighandler);
+        vlock_tick_hz = frame_clock_fps("wetpipes", WETPIPES_FPS);
+        in_process = true;
+        return true;
+    }
 
-    if(!create_child(&wetpipes_proc, &tmp_error))
+    vlock_tick_hz = 0;
+
+    /* wake the child that was suspended on the last key press, if it
+       is still there -- it repaints the whole screen when continued */
+    if(wetpipes_proc.pid > 0)
+    {
+        (void)screen_begin();
+
+        if(supervisor_resume(wetpipes_proc.pid))
+        {
+            *ctx_ptr = &wetpipes_proc;
+            return true;
+        }
+    }
+
+    if(!init_screen()) return false;
+
+    resource_policy_from_env("wetpipes", &policy);
+
+    if(!supervisor_spawn("wetpipes", &wetpipes_proc, true, &tmp_error))
         return false;
 
     *ctx_ptr = &wetpipes_proc;
     return true;
 }
 
+bool vlock_tick(void **ctx_ptr, uint64_t now)
+{
+    (void)ctx_ptr;
+    (void)now;
+
+    draw_next_frame(NULL);
+    return true;
+}
+
 bool vlock_save_abort(void **ctx_ptr)
 {
     struct child_process *proc = *ctx_ptr;
 
-    if(proc != NULL)
+    if(proc != NULL || in_process)
     {
-        ensure_death(proc->pid);
+        /* keep the child for a quick resume on the next vlock_save */
+        if(proc != NULL) supervisor_suspend(proc->pid);
 
-        curs_set(1);
-        clear();
-        refresh();
-        resetty();
-        endwin();
+        screen_suspend();
 
         *ctx_ptr = NULL;
+        in_process = false;
     }
 
-    if(pipes != NULL) { free(pipes); pipes = NULL; }
-
     return true;
 }
 
@@ -250,6 +359,13 @@ sighandler(int s)
     signal_status = s;
 }
 
+static void
+handle_sigcont(int s)
+{
+    (void)s;
+    repaint = 1;
+}
+
 static void
 init_colors(void)
 {
@@ -306,12 +422,12 @@ bubble_maybe_grow(bubble_kind_t k)
     switch(k)
     {
         case BUB_DOT:
-            r = rand() % 100;
+            r = prng_below(&rng, 100);
             if(r < 15) return BUB_COLON;
             if(r < 30) return BUB_SMALL;
             return BUB_DOT;
         case BUB_SMALL:
-            r = rand() % 100;
+            r = prng_below(&rng, 100);
             if(r < 15) return BUB_LARGE;
             if(r < 30) return BUB_FAT;
             return BUB_SMALL;
@@ -346,7 +462,7 @@ update_bubbles(int frame, int sky_h)
            each color) but never two of the same color. */
         if(frame >= pp->next_emit_frame)
         {
-            bubble_color_t color = (rand() & 1) ? BUB_COLOR_WHITE
+            bubble_color_t color = (prng_next(&rng) & 1) ? BUB_COLOR_WHITE
                                                 : BUB_COLOR_BLUE;
             int free_idx[MAX_STREAMS_PER_PIPE];
             int free_count = 0;
@@ -359,7 +475,7 @@ update_bubbles(int frame, int sky_h)
             if(free_count > 0)
             {
                 bubble_t *bb;
-                chosen = free_idx[rand() % free_count];
+                chosen = free_idx[prng_below(&rng, free_count)];
                 bb = &pp->bubbles[chosen][color];
                 bb->x = pp->stream_x[chosen];
                 bb->y = pp->y_top - 1;
@@ -376,7 +492,7 @@ update_bubbles(int frame, int sky_h)
                harmless no-ops; the only effect of a faster cadence
                is that freshly-vanished slots get refilled almost
                immediately. */
-            pp->next_emit_frame = frame + (rand() % 2);
+            pp->next_emit_frame = frame + prng_below(&rng, 2);
         }
 
         /* update each active bubble (every (stream, color) slot) */
@@ -437,7 +553,7 @@ update_bubbles(int frame, int sky_h)
     Called each frame AFTER overwrite(static_canvas, stdscr) has
     blitted the static scene -- the blit naturally cleared every
     previous-frame bubble cell, so we don't need a separate erase
-    pass at all.  ncurses' refresh diffs the final stdscr against the
+    pass at all.  render_refresh() diffs the final stdscr against the
     physical terminal and pushes only the cells that genuinely
     changed (in practice: old bubble cells now showing bg, new
     bubble cells now showing the glyph).
@@ -497,7 +613,7 @@ compute_pipes(void)
     /* Pick 2 or 3 pipes, then drop down to 2 if 3 won't fit even with
        a minimal gap.  Shaft width must stay even (the underline split
        relies on shaft_w / 2). */
-    count = MIN_PIPES + (rand() % (MAX_PIPES - MIN_PIPES + 1));
+    count = MIN_PIPES + prng_below(&rng, MAX_PIPES - MIN_PIPES + 1);
 
     while(count > 0)
     {
@@ -519,7 +635,7 @@ compute_pipes(void)
     for(i = 0; i < count; i++)
     {
         int height = MIN_PIPE_HEIGHT
-            + (rand() % (max_height - MIN_PIPE_HEIGHT + 1));
+            + prng_below(&rng, max_height - MIN_PIPE_HEIGHT + 1);
         int slot_x = i * slot_w;
         int pipe_x = slot_x + (slot_w - flange_w) / 2;
         int sc, s;
@@ -530,7 +646,7 @@ compute_pipes(void)
         pipes[i].y_top   = brick_top - height;
         pipes[i].shaft_w = shaft_w;
         pipes[i].height  = height;
-        pipes[i].kind    = (rand() & 1) ? PIPE_KIND_GREEN : PIPE_KIND_GRAY;
+        pipes[i].kind    = (prng_next(&rng) & 1) ? PIPE_KIND_GREEN : PIPE_KIND_GRAY;
 
         /* Fixed stream count per pipe -- the shaft is sized to give
            exactly shaft_w - 1 = 12 usable columns. */
@@ -546,7 +662,7 @@ compute_pipes(void)
                                  : (s * span) / (sc - 1);
             pipes[i].stream_x[s] = pipe_x + 1 + 1 + off;
         }
-        pipes[i].next_emit_frame = rand() % 20;
+        pipes[i].next_emit_frame = prng_below(&rng, 20);
         /* calloc zeroed the bubbles[] array, .alive=false already */
     }
 
@@ -565,7 +681,7 @@ compute_pipes(void)
         }
         if(!has_green || !has_gray)
         {
-            int flip = rand() % count;
+            int flip = prng_below(&rng, count);
             pipes[flip].kind = has_green ? PIPE_KIND_GRAY
                                          : PIPE_KIND_GREEN;
         }
@@ -777,13 +893,11 @@ resize_screen(void)
     compute_pipes();
 }
 
-static int
-wetpipes_main(void *argument)
+/* set up the scene once the screen is initialized, in vlock-main or in
+   the child */
+static void
+setup_scene(void)
 {
-    (void)argument;
-
-    srand((unsigned)time(NULL));
-
     if(LINES < 10) LINES = 10;
     if(COLS  < 10) COLS  = 10;
 
@@ -802,48 +916,88 @@ wetpipes_main(void *argument)
        paint the rest of the line black */
     bkgdset(' ' | COLOR_PAIR(PAIR_BG));
 
-    compute_pipes();
+    /* unless vlock_prepare() did for this size already */
+    if(LINES != prepared_lines || COLS != prepared_cols)
+    {
+        prng_init(&rng, "wetpipes");
+        compute_pipes();
+    }
+
+    /* children cloned from the zygote all got the same generator with the
+       pipes, so each one seeds its own to not replay the others */
+    prng_init(&rng, "wetpipes");
+
     build_static_canvas();
     overwrite(static_canvas, stdscr);
     info_box_draw();
     refresh();
 
+    frame = 0;
+    sky_h = (LINES * SKY_FRACTION) / 100;
+    if(sky_h < 1) sky_h = 1;
+}
+
+static void
+draw_next_frame(struct frame_clock *clock)
+{
+    if(signal_status == SIGWINCH)
     {
-        int frame = 0;
-        int sky_h = (LINES * SKY_FRACTION) / 100;
+        resize_screen();
+        sky_h = (LINES * SKY_FRACTION) / 100;
         if(sky_h < 1) sky_h = 1;
+        /* rebuild canvas at the new geometry */
+        build_static_canvas();
+        signal_status = 0;
+    }
 
-        while(1)
-        {
-            if(signal_status == SIGINT) return 0;
-            if(signal_status == SIGWINCH)
-            {
-                resize_screen();
-                sky_h = (LINES * SKY_FRACTION) / 100;
-                if(sky_h < 1) sky_h = 1;
-                /* rebuild canvas at the new geometry */
-                build_static_canvas();
-                signal_status = 0;
-            }
+    update_bubbles(frame, sky_h);
+    if(clock != NULL) frame_clock_updated(clock);
 
-            /* drain input non-blockingly -- the parent vlock-main is
-               the one watching for the wake key and will kill us via
-               vlock_save_abort.  Just discard anything we see. */
-            (void)wgetch(stdscr);
+    /* blit the pre-rendered static scene onto stdscr (this clears
+       every prior bubble cell), overlay the bubbles at their new
+       positions, and push */
+    overwrite(static_canvas, stdscr);
+    draw_bubbles();
+    info_box_draw();
+    render_refresh();
+    info_box_done();
 
-            update_bubbles(frame, sky_h);
+    /* bubble periods count drawn frames, so skipped frames do not
+       advance them */
+    frame++;
+}
 
-            /* blit the pre-rendered static scene onto stdscr (this
-               clears every prior bubble cell), overlay the bubbles at
-               their new positions, and push */
-            overwrite(static_canvas, stdscr);
-            draw_bubbles();
-            info_box_draw();
-            wnoutrefresh(stdscr);
-            doupdate();
+static int
+wetpipes_main(void *argument)
+{
+    struct frame_clock clock;
 
-            napms(80);
-            frame++;
+    (void)argument;
+
+    if(stdscr == NULL && !init_screen()) return 1;
+
+    signal(SIGCONT, handle_sigcont);
+
+    setup_scene();
+    frame_clock_init(&clock, "wetpipes", WETPIPES_FPS);
+
+    while(1)
+    {
+        if(signal_status == SIGINT) return 0;
+
+        /* drain input non-blockingly -- the parent vlock-main is the
+           one watching for the wake key and will kill us via
+           vlock_save_abort.  Just discard anything we see. */
+        (void)wgetch(stdscr);
+
+        if(repaint)
+        {
+            /* the screen was used for the password prompt */
+            repaint = 0;
+            clearok(curscr, TRUE);
         }
+
+        draw_next_frame(&clock);
+        (void)frame_clock_wait(&clock);
     }
 }
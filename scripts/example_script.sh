@@ -39,6 +39,12 @@ hooks() {
         # abort a screensaver type action here
       ;;
     esac
+
+    # With "protocol": 2 in the configuration vlock waits until the hook is
+    # acknowledged.  Report failures with "error <hook> <message>" instead.
+    if [ "${VLOCK_EXAMPLE_SCRIPT_PROTOCOL:-1}" = 2 ] ; then
+      echo "ok ${hook_name}"
+    fi
   done
 }
 
@@ -0,0 +1,201 @@
+/* events.c -- event sources for vlock, the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* While vlock waits for a key press it can also watch other file descriptors
+ * and timers, e.g. to notice that a child process died.  The sources are
+ * serviced from the select() loop in read_character(). */
+
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include "util.h"
+#include "events.h"
+
+struct fd_source
+{
+  int fd;
+  event_callback callback;
+  void *data;
+};
+
+struct timer_source
+{
+  unsigned int id;
+  uint64_t deadline;
+  event_callback callback;
+  void *data;
+};
+
+static GList *fd_sources = NULL;
+/* Sorted by deadline. */
+static GList *timer_sources = NULL;
+/* Timers that are due and not called yet by events_dispatch(). */
+static GList *due_timers = NULL;
+
+static unsigned int last_timer_id = 0;
+
+static GList *find_fd(int fd)
+{
+  for (GList *item = fd_sources; item != NULL; item = g_list_next(item)) {
+    struct fd_source *source = item->data;
+
+    if (source->fd == fd)
+      return item;
+  }
+
+  return NULL;
+}
+
+void events_add_fd(int fd, event_callback callback, void *data)
+{
+  struct fd_source *source;
+
+  g_return_if_fail(fd >= 0 && fd < FD_SETSIZE);
+  g_return_if_fail(find_fd(fd) == NULL);
+
+  source = g_malloc(sizeof *source);
+  source->fd = fd;
+  source->callback = callback;
+  source->data = data;
+
+  fd_sources = g_list_append(fd_sources, source);
+}
+
+void events_remove_fd(int fd)
+{
+  GList *item = find_fd(fd);
+
+  if (item != NULL) {
+    g_free(item->data);
+    fd_sources = g_list_delete_link(fd_sources, item);
+  }
+}
+
+static gint compare_deadline(gconstpointer a, gconstpointer b)
+{
+  const struct timer_source *x = a;
+  const struct timer_source *y = b;
+
+  if (x->deadline != y->deadline)
+    return x->deadline < y->deadline ? -1 : 1;
+
+  /* Keep the order of insertion for equal deadlines. */
+  return x->id < y->id ? -1 : 1;
+}
+
+unsigned int events_add_timer(uint64_t deadline, event_callback callback,
+                              void *data)
+{
+  struct timer_source *source = g_malloc(sizeof *source);
+
+  if (++last_timer_id == 0)
+    last_timer_id = 1;
+
+  source->id = last_timer_id;
+  source->deadline = deadline;
+  source->callback = callback;
+  source->data = data;
+
+  timer_sources = g_list_insert_sorted(timer_sources, source,
+                                       compare_deadline);
+
+  return source->id;
+}
+
+static bool remove_timer(GList **list, unsigned int id)
+{
+  for (GList *item = *list; item != NULL; item = g_list_next(item)) {
+    struct timer_source *source = item->data;
+
+    if (source->id == id) {
+      g_free(source);
+      *list = g_list_delete_link(*list, item);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void events_remove_timer(unsigned int id)
+{
+  /* A timer that is due with another one is cancelled as well, in case the
+   * other one's callback removes it. */
+  if (!remove_timer(&timer_sources, id))
+    (void) remove_timer(&due_timers, id);
+}
+
+int events_prepare(fd_set *readfds, int maxfd, uint64_t *deadline)
+{
+  for (GList *item = fd_sources; item != NULL; item = g_list_next(item)) {
+    struct fd_source *source = item->data;
+
+    FD_SET(source->fd, readfds);
+
+    if (source->fd > maxfd)
+      maxfd = source->fd;
+  }
+
+  if (timer_sources != NULL) {
+    struct timer_source *first = timer_sources->data;
+
+    if (*deadline == 0 || first->deadline < *deadline)
+      *deadline = first->deadline;
+  }
+
+  return maxfd;
+}
+
+void events_dispatch(const fd_set *readfds)
+{
+  uint64_t now = monotonic_ns();
+  GList *ready = NULL;
+
+  /* Callbacks may add or remove sources, so collect the ready descriptors
+   * first and look each one up again before calling it. */
+  for (GList *item = fd_sources; item != NULL; item = g_list_next(item)) {
+    struct fd_source *source = item->data;
+
+    if (FD_ISSET(source->fd, readfds))
+      ready = g_list_append(ready, GINT_TO_POINTER(source->fd));
+  }
+
+  while (ready != NULL) {
+    GList *item = find_fd(GPOINTER_TO_INT(ready->data));
+
+    if (item != NULL) {
+      struct fd_source *source = item->data;
+      source->callback(source->data);
+    }
+
+    ready = g_list_delete_link(ready, ready);
+  }
+
+  /* Detach the due timers first.  Timers added by their callbacks run the
+   * next time around. */
+  while (timer_sources != NULL
+         && ((struct timer_source *) timer_sources->data)->deadline <= now) {
+    due_timers = g_list_append(due_timers, timer_sources->data);
+    timer_sources = g_list_delete_link(timer_sources, timer_sources);
+  }
+
+  /* Taken off the list before it is called, so callbacks only remove the
+   * ones still to come. */
+  while (due_timers != NULL) {
+    struct timer_source *source = due_timers->data;
+
+    due_timers = g_list_delete_link(due_timers, due_timers);
+    source->callback(source->data);
+    g_free(source);
+  }
+}
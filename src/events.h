@@ -0,0 +1,47 @@
+/* events.h -- header file for the event sources of vlock,
+ *             the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/select.h>
+
+typedef void (*event_callback)(void *data);
+
+/* Call the given function whenever the given file descriptor becomes
+ * readable while vlock waits for input.  A descriptor can only be watched
+ * once. */
+void events_add_fd(int fd, event_callback callback, void *data);
+
+/* Stop watching the given file descriptor. */
+void events_remove_fd(int fd);
+
+/* Call the given function once the monotonic clock (see monotonic_ns())
+ * reaches the given deadline.  Returns an id for events_remove_timer() that is
+ * never 0. */
+unsigned int events_add_timer(uint64_t deadline, event_callback callback,
+                              void *data);
+
+/* Cancel the timer with the given id, also from the callback of another
+ * timer that is due at the same time.  Does nothing if it already fired. */
+void events_remove_timer(unsigned int id);
+
+/* Add the watched file descriptors to the given set and return the highest
+ * descriptor in it, which is at least maxfd.  If a timer is due before the
+ * given deadline (0 meaning none) the deadline is moved to it. */
+int events_prepare(fd_set *readfds, int maxfd, uint64_t *deadline);
+
+/* Call the callbacks of the watched descriptors that are set in the given
+ * set and of all timers that are due. */
+void events_dispatch(const fd_set *readfds);
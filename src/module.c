@@ -35,10 +35,20 @@
 
 #include "plugin.h"
 #include "module.h"
+#include "watchdog.h"
 
 /* A hook function as defined by a module. */
 typedef bool (*module_hook_function)(void **);
 
+/* The tick function as defined by a module. */
+typedef bool (*module_tick_function)(void **, uint64_t);
+
+/* The prepare function as defined by a module. */
+typedef void (*module_prepare_function)(void);
+
+/* Tick rate of a module that defines vlock_tick but not vlock_tick_hz. */
+#define DEFAULT_TICK_HZ 25
+
 struct _VlockModulePrivate
 {
   /* Handle returned by dlopen(). */
@@ -50,6 +60,13 @@ struct _VlockModulePrivate
   /* Array of hook functions befined by a single module.  Stored in the same
    * order as the global hooks. */
   module_hook_function hooks[nr_hooks];
+
+  /* The module's vlock_tick and vlock_tick_hz, NULL if not defined. */
+  module_tick_function tick;
+  const unsigned int *tick_hz;
+
+  /* The module's vlock_prepare, NULL if not defined. */
+  module_prepare_function prepare;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE(VlockModule, vlock_module, TYPE_VLOCK_PLUGIN)
@@ -106,6 +123,13 @@ static bool vlock_module_open(VlockPlugin *plugin, GError **error)
     memcpy(&self->priv->hooks[i], &sym, sizeof sym);
   }
 
+  void *tick = dlsym(dl_handle, "vlock_tick");
+  memcpy(&self->priv->tick, &tick, sizeof tick);
+  self->priv->tick_hz = dlsym(dl_handle, "vlock_tick_hz");
+
+  void *prepare = dlsym(dl_handle, "vlock_prepare");
+  memcpy(&self->priv->prepare, &prepare, sizeof prepare);
+
   /* Load all dependencies.  Unspecified dependencies are NULL. */
   for (size_t i = 0; i < nr_dependencies; i++) {
     const char *(*dependency)[] = dlsym(dl_handle, dependency_names[i]);
@@ -121,6 +145,20 @@ static bool vlock_module_open(VlockPlugin *plugin, GError **error)
   return true;
 }
 
+/* Read the tick rate the module asks for.  A module without vlock_tick is
+ * never ticked; one that sets vlock_tick_hz to 0 is not ticked either. */
+static void vlock_module_update_tick_hz(VlockModule *self)
+{
+  VlockPlugin *plugin = VLOCK_PLUGIN(self);
+
+  if (self->priv->tick == NULL)
+    plugin->tick_hz = 0;
+  else if (self->priv->tick_hz == NULL)
+    plugin->tick_hz = DEFAULT_TICK_HZ;
+  else
+    plugin->tick_hz = MIN(*self->priv->tick_hz, 1000);
+}
+
 static bool vlock_module_call_hook(VlockPlugin *plugin, const gchar *hook_name)
 {
   VlockModule *self = VLOCK_MODULE(plugin);
@@ -129,19 +167,56 @@ static bool vlock_module_call_hook(VlockPlugin *plugin, const gchar *hook_name)
   for (size_t i = 0; i < nr_hooks; i++)
     if (strcmp(hooks[i].name, hook_name) == 0) {
       module_hook_function hook = self->priv->hooks[i];
+      bool result;
+
+      if (hook == NULL)
+        break;
+
+      watchdog_arm(plugin->name, i);
+      result = hook(&self->priv->hook_context);
+
+      /* A hook that overran its deadline has failed, whatever it returned. */
+      if (watchdog_disarm()) {
+        errno = ETIMEDOUT;
+        return false;
+      }
 
-      if (hook != NULL)
-        return hook(&self->priv->hook_context);
+      /* The module may have chosen to render in a child process instead. */
+      if (result && strcmp(hook_name, "vlock_save") == 0)
+        vlock_module_update_tick_hz(self);
+
+      return result;
     }
 
   return true;
 }
 
+static bool vlock_module_tick(VlockPlugin *plugin, uint64_t now)
+{
+  VlockModule *self = VLOCK_MODULE(plugin);
+
+  if (self->priv->tick == NULL)
+    return true;
+
+  return self->priv->tick(&self->priv->hook_context, now);
+}
+
+static void vlock_module_prepare(VlockPlugin *plugin)
+{
+  VlockModule *self = VLOCK_MODULE(plugin);
+
+  if (self->priv->prepare != NULL)
+    self->priv->prepare();
+}
+
 /* Initialize plugin to default values. */
 static void vlock_module_init(VlockModule *self)
 {
   self->priv = vlock_module_get_instance_private(self);
   self->priv->dl_handle = NULL;
+  self->priv->tick = NULL;
+  self->priv->tick_hz = NULL;
+  self->priv->prepare = NULL;
 }
 
 /* Destroy module object. */
@@ -168,5 +243,7 @@ static void vlock_module_class_init(VlockModuleClass *klass)
 
   plugin_class->open = vlock_module_open;
   plugin_class->call_hook = vlock_module_call_hook;
+  plugin_class->tick = vlock_module_tick;
+  plugin_class->prepare = vlock_module_prepare;
 }
 
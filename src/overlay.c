@@ -0,0 +1,154 @@
+/* overlay.c -- password prompt overlay for vlock,
+ *              the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* Normally a key press stops the screen savers before the password prompt is
+ * shown on a cleared screen.  With the overlay the savers keep running and
+ * the prompt gets the bottom rows of the screen.  A scroll region keeps the
+ * prompt's output within them.  The savers learn about the prompt through a
+ * shared page: they lower their frame rate and do not draw over its rows (see
+ * modules/info_box.c and modules/frame_clock.c). */
+
+#if !defined(__FreeBSD__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include <glib.h>
+
+#include "overlay.h"
+
+/* Rows of the prompt, including the separator line. */
+#define OVERLAY_ROWS 5
+
+#define DEFAULT_OVERLAY_FPS 2
+
+/* How long to give the savers to finish a frame they already started
+ * drawing before the prompt is shown. */
+#define OVERLAY_SETTLE_MS 100
+
+static struct overlay *state = NULL;
+
+static bool value_is_true(const char *value)
+{
+  return value != NULL
+    && (strcmp(value, "1") == 0 || strcmp(value, "y") == 0
+        || strcmp(value, "yes") == 0 || strcmp(value, "true") == 0
+        || strcmp(value, "on") == 0);
+}
+
+void overlay_init(void)
+{
+  const char *fps = g_getenv("VLOCK_PROMPT_OVERLAY_FPS");
+  void *page;
+
+  if (!value_is_true(g_getenv("VLOCK_PROMPT_OVERLAY")))
+    return;
+
+  page = mmap(NULL, sizeof *state, PROT_READ | PROT_WRITE,
+              MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+  if (page == MAP_FAILED) {
+    g_warning("prompt overlay disabled: %s", g_strerror(errno));
+    return;
+  }
+
+  state = page;
+  state->generation = 0;
+  state->fps = DEFAULT_OVERLAY_FPS;
+
+  if (fps != NULL) {
+    char *end;
+    long n = strtol(fps, &end, 10);
+
+    if (*end == '\0' && n > 0 && n <= 1000)
+      state->fps = n;
+  }
+}
+
+const struct overlay *overlay_get(void)
+{
+  return state;
+}
+
+bool overlay_active(void)
+{
+  return state != NULL && state->generation % 2 == 1;
+}
+
+bool overlay_begin(void)
+{
+  struct winsize ws;
+  struct timespec settle = {
+    .tv_sec = 0,
+    .tv_nsec = OVERLAY_SETTLE_MS * 1000000L,
+  };
+  int lines = 24;
+  int columns = 80;
+
+  if (state == NULL)
+    return false;
+
+  if (overlay_active())
+    return true;
+
+  if (ioctl(STDIN_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0) {
+    lines = ws.ws_row;
+    columns = ws.ws_col;
+  }
+
+  state->rows = MIN(OVERLAY_ROWS, lines);
+  state->top = lines - state->rows;
+  __sync_synchronize();
+  state->generation++;
+
+  (void) nanosleep(&settle, NULL);
+
+  fflush(stdout);
+
+  /* Separator line, then clear the rest and confine scrolling to it. */
+  fprintf(stderr, "\033[%d;1H\033[0m", state->top + 1);
+
+  for (int i = 0; i < columns; i++)
+    fputc('-', stderr);
+
+  for (int row = state->top + 2; row <= lines; row++)
+    fprintf(stderr, "\033[%d;1H\033[2K", row);
+
+  fprintf(stderr, "\033[%d;%dr\033[%d;1H\033[?25h",
+          MIN(state->top + 2, lines), lines, MIN(state->top + 2, lines));
+  fflush(stderr);
+
+  return true;
+}
+
+void overlay_end(void)
+{
+  if (!overlay_active())
+    return;
+
+  /* Reset the scroll region and hide the cursor again.  The savers repaint
+   * the rows themselves. */
+  fputs("\033[r\033[?25l", stderr);
+  fflush(stderr);
+
+  __sync_synchronize();
+  state->generation++;
+}
@@ -0,0 +1,49 @@
+/* overlay.h -- header file for the password prompt overlay of vlock,
+ *              the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+/* State of the prompt overlay.  It lives in a page shared with all children,
+ * so screen savers see the prompt come and go without being told. */
+struct overlay
+{
+  /* Incremented whenever the prompt is shown or removed, so it is odd while
+   * the prompt is shown. */
+  volatile unsigned int generation;
+  /* First screen row (counting from 0) and number of rows of the prompt. */
+  volatile int top;
+  volatile int rows;
+  /* Frame rate of the screen savers while the prompt is shown. */
+  unsigned int fps;
+};
+
+/* Set up the overlay if VLOCK_PROMPT_OVERLAY is true.  Must be called before
+ * any child that should see it is forked, i.e. before zygote_start(). */
+void overlay_init(void);
+
+/* Return the overlay state, or NULL if the overlay is not enabled. */
+const struct overlay *overlay_get(void);
+
+/* Return true if the overlay is enabled and the prompt is shown. */
+bool overlay_active(void);
+
+/* Reserve the bottom rows of the screen for the password prompt and move the
+ * cursor there.  Screen savers keep running behind it at a reduced frame rate.
+ * Returns false if the overlay is not enabled; the savers should then be
+ * stopped before prompting. */
+bool overlay_begin(void);
+
+/* Give the rows of the prompt back to the screen savers. */
+void overlay_end(void);
@@ -32,6 +32,7 @@ static void vlock_plugin_init(VlockPlugin *self)
 {
   self->name = NULL;
   self->save_disabled = false;
+  self->tick_hz = 0;
   for (size_t i = 0; i < nr_dependencies; i++)
     self->dependencies[i] = NULL;
 }
@@ -135,6 +136,8 @@ static void vlock_plugin_class_init(VlockPluginClass *klass)
   /* Virtual methods. */
   klass->open = NULL;
   klass->call_hook = NULL;
+  klass->tick = NULL;
+  klass->prepare = NULL;
 
   /* Install overridden methods. */
   gobject_class->constructor = vlock_plugin_constructor;
@@ -172,3 +175,21 @@ bool vlock_plugin_call_hook(VlockPlugin *self, const gchar *hook_name)
   return klass->call_hook(self, hook_name);
 }
 
+bool vlock_plugin_tick(VlockPlugin *self, uint64_t now)
+{
+  VlockPluginClass *klass = VLOCK_PLUGIN_GET_CLASS(self);
+
+  if (klass->tick == NULL)
+    return true;
+
+  return klass->tick(self, now);
+}
+
+
+void vlock_plugin_prepare(VlockPlugin *self)
+{
+  VlockPluginClass *klass = VLOCK_PLUGIN_GET_CLASS(self);
+
+  if (klass->prepare != NULL)
+    klass->prepare(self);
+}
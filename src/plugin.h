@@ -14,6 +14,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <glib.h>
 #include <glib-object.h>
 
@@ -71,6 +72,10 @@ struct _VlockPlugin
   GList *dependencies[nr_dependencies];
 
   bool save_disabled;
+
+  /* How often per second the plugin wants its tick method called while the
+   * screen is saved, 0 if never.  Updated after each "vlock_save" hook. */
+  unsigned int tick_hz;
 };
 
 struct _VlockPluginClass
@@ -79,6 +84,8 @@ struct _VlockPluginClass
 
   bool (*open)(VlockPlugin *self, GError **error);
   bool (*call_hook)(VlockPlugin *self, const gchar *hook_name);
+  bool (*tick)(VlockPlugin *self, uint64_t now);
+  void (*prepare)(VlockPlugin *self);
 };
 
 GType vlock_plugin_get_type(void);
@@ -89,3 +96,11 @@ bool vlock_plugin_open(VlockPlugin *self, GError **error);
 GList *vlock_plugin_get_dependencies(VlockPlugin *self,
                                      const gchar *dependency_name);
 bool vlock_plugin_call_hook(VlockPlugin *self, const gchar *hook_name);
+
+/* Let the plugin render one frame of its screen saver.  now is the value of
+ * monotonic_ns().  Returns false if the plugin failed. */
+bool vlock_plugin_tick(VlockPlugin *self, uint64_t now);
+
+/* Let the plugin precompute the state of its screen saver before the screen
+ * is saved.  Runs in the process the saver will be started from. */
+void vlock_plugin_prepare(VlockPlugin *self);
@@ -25,6 +25,11 @@
 #include "plugin.h"
 #include "module.h"
 #include "script.h"
+#include "profile.h"
+#include "events.h"
+#include "overlay.h"
+#include "powersave.h"
+#include "telemetry.h"
 
 #include "util.h"
 
@@ -99,7 +104,11 @@ void plugin_hook(const char *hook_name)
   for (size_t i = 0; i < nr_hooks; i++)
     /* Get the handler and call it. */
     if (strcmp(hook_name, hooks[i].name) == 0) {
+      uint64_t start = monotonic_ns();
+
       hooks[i].handler(hook_name);
+      /* Account the whole round, e.g. the total time to lock. */
+      profile_record("(all)", hooks[i].name, monotonic_ns() - start);
       break;
     }
 }
@@ -402,6 +411,150 @@ static GList *get_edges(void)
 /* handlers */
 /************/
 
+/* Call the hook of the given plugin and record how long it took. */
+static bool call_hook(VlockPlugin *p, const char *hook_name)
+{
+  uint64_t start = monotonic_ns();
+  bool result = vlock_plugin_call_hook(p, hook_name);
+  /* Keep errno for the caller's error message. */
+  int errsv = errno;
+
+  profile_record(p->name, hook_name, monotonic_ns() - start);
+  errno = errsv;
+
+  return result;
+}
+
+/* A plugin that renders its screen saver from vlock's event loop. */
+struct ticker
+{
+  VlockPlugin *plugin;
+  struct saver_telemetry *telemetry;
+  uint64_t period;
+  uint64_t next;
+  unsigned int timer;
+};
+
+/* Plugins that are ticked while the screen is saved. */
+static GList *tickers = NULL;
+
+static void tick(void *data)
+{
+  struct ticker *t = data;
+  VlockPlugin *p = t->plugin;
+  uint64_t now = monotonic_ns();
+  bool result = vlock_plugin_tick(p, now);
+  uint64_t elapsed = monotonic_ns() - now;
+  unsigned int max_fps;
+
+  profile_record(p->name, "vlock_tick", elapsed);
+
+  if (result && t->telemetry != NULL) {
+    /* Ticks run in vlock-main, so there is no process of the saver's own
+     * to sample. */
+    t->telemetry->render_ns += elapsed;
+    t->telemetry->frames++;
+    telemetry_frame_done(t->telemetry);
+  }
+
+  if (!result) {
+    /* Handle it like a failed "vlock_save" hook. */
+    tickers = g_list_remove(tickers, t);
+    g_free(t);
+    p->save_disabled = true;
+    (void) call_hook(p, "vlock_save_abort");
+    return;
+  }
+
+  /* Skip ticks that were missed instead of catching up, and slow down
+   * behind the password prompt or when dimmed.  The limit is read once, like
+   * the savers in their own processes do. */
+  max_fps = powersave_max_fps();
+
+  if (overlay_active())
+    t->next += MAX(t->period, 1000000000 / overlay_get()->fps);
+  else if (max_fps > 0)
+    t->next += MAX(t->period, 1000000000 / max_fps);
+  else
+    t->next += t->period;
+
+  if (t->next <= now) {
+    if (t->telemetry != NULL)
+      t->telemetry->dropped += (now - t->next) / t->period + 1;
+
+    t->next = now + t->period;
+  }
+
+  t->timer = events_add_timer(t->next, tick, t);
+}
+
+/* Start calling the tick method of the given plugin.  The first tick is due
+ * right away. */
+static void start_ticking(VlockPlugin *p)
+{
+  struct ticker *t = g_new(struct ticker, 1);
+
+  t->plugin = p;
+  t->telemetry = telemetry_find(p->name);
+  telemetry_attach(t->telemetry);
+  t->period = 1000000000 / p->tick_hz;
+  t->next = monotonic_ns();
+  t->timer = events_add_timer(t->next, tick, t);
+
+  tickers = g_list_append(tickers, t);
+}
+
+static void stop_ticking(void)
+{
+  while (tickers != NULL) {
+    struct ticker *t = tickers->data;
+
+    if (t->timer != 0)
+      events_remove_timer(t->timer);
+
+    g_free(t);
+    tickers = g_list_delete_link(tickers, tickers);
+  }
+}
+
+void plugins_pause_ticks(void)
+{
+  for (GList *item = tickers; item != NULL; item = g_list_next(item)) {
+    struct ticker *t = item->data;
+
+    if (t->timer != 0) {
+      events_remove_timer(t->timer);
+      t->timer = 0;
+    }
+  }
+}
+
+void plugins_resume_ticks(void)
+{
+  uint64_t now = monotonic_ns();
+
+  for (GList *item = tickers; item != NULL; item = g_list_next(item)) {
+    struct ticker *t = item->data;
+
+    if (t->timer == 0) {
+      t->next = now;
+      t->timer = events_add_timer(t->next, tick, t);
+    }
+  }
+}
+
+void plugins_prepare(void)
+{
+  for (GList *item = plugins; item != NULL; item = g_list_next(item)) {
+    VlockPlugin *p = item->data;
+    uint64_t start = monotonic_ns();
+
+    vlock_plugin_prepare(p);
+    g_debug("prepared %s in %" G_GUINT64_FORMAT " us", p->name,
+            (monotonic_ns() - start) / 1000);
+  }
+}
+
 /* Call the "vlock_start" hook of each plugin.  Fails if the hook of one of the
  * plugins fails.  In this case the "vlock_end" hooks of all plugins that were
  * called before are called in reverse order. */
@@ -412,14 +565,14 @@ void handle_vlock_start(const char *hook_name)
        plugin_item = g_list_next(plugin_item)) {
     VlockPlugin *p = plugin_item->data;
 
-    if (!vlock_plugin_call_hook(p, hook_name)) {
+    if (!call_hook(p, hook_name)) {
       int errsv = errno;
 
       for (GList *reverse_item = g_list_previous(plugin_item);
            reverse_item != NULL;
            reverse_item = g_list_previous(reverse_item)) {
         VlockPlugin *r = reverse_item->data;
-        (void) vlock_plugin_call_hook(r, "vlock_end");
+        (void) call_hook(r, "vlock_end");
       }
 
       if (errsv)
@@ -438,7 +591,7 @@ void handle_vlock_end(const char *hook_name)
        plugin_item != NULL;
        plugin_item = g_list_previous(plugin_item)) {
     VlockPlugin *p = plugin_item->data;
-    (void) vlock_plugin_call_hook(p, hook_name);
+    (void) call_hook(p, hook_name);
   }
 }
 
@@ -455,9 +608,13 @@ void handle_vlock_save(const char *hook_name)
     if (p->save_disabled)
       continue;
 
-    if (!vlock_plugin_call_hook(p, hook_name)) {
+    telemetry_save_started(p->name);
+
+    if (!call_hook(p, hook_name)) {
       p->save_disabled = true;
-      (void) vlock_plugin_call_hook(p, "vlock_save_abort");
+      (void) call_hook(p, "vlock_save_abort");
+    } else if (p->tick_hz > 0) {
+      start_ticking(p);
     }
   }
 }
@@ -467,15 +624,27 @@ void handle_vlock_save(const char *hook_name)
  * again afterwards. */
 void handle_vlock_save_abort(const char *hook_name)
 {
+  stop_ticking();
+
   for (GList *plugin_item = g_list_last(plugins);
        plugin_item != NULL;
        plugin_item = g_list_previous(plugin_item)) {
     VlockPlugin *p = plugin_item->data;
+    uint64_t first_frame = telemetry_first_frame_ns(p->name);
+
+    if (first_frame > 0) {
+      /* Tracked like a hook, so it shows up in the profile report. */
+      profile_record(p->name, "first_frame", first_frame);
+      g_debug("%s showed its first frame after %" G_GUINT64_FORMAT " us",
+              p->name, first_frame / 1000);
+    }
+
+    telemetry_log(p->name);
 
     if (p->save_disabled)
       continue;
 
-    if (!vlock_plugin_call_hook(p, hook_name))
+    if (!call_hook(p, hook_name))
       p->save_disabled = true;
   }
 }
@@ -28,3 +28,12 @@ void unload_plugins(void);
 
 /* Call the given plugin hook. */
 void plugin_hook(const char *hook_name);
+
+/* Stop and restart calling the tick methods of the plugins that save the
+ * screen, e.g. while it is blanked. */
+void plugins_pause_ticks(void);
+void plugins_resume_ticks(void);
+
+/* Let all plugins precompute their screen savers.  Called by the zygote while
+ * it is idle, or by vlock-main after the "vlock_start" hook. */
+void plugins_prepare(void);
@@ -0,0 +1,177 @@
+/* powersave.c -- screen saver power stages for vlock,
+ *                the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* A screen saver left alone for a long time first runs at a low frame rate
+ * and is then stopped altogether with the screen blanked, so an unattended
+ * console does not keep a CPU busy.  The frame rate limit lives in a page
+ * shared with the saver children, which read it in frame_clock_wait(). */
+
+#if !defined(__FreeBSD__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+
+#ifdef __linux__
+#include <linux/tiocl.h>
+#endif
+
+#include <glib.h>
+
+#include "util.h"
+#include "events.h"
+#include "plugins.h"
+#include "supervisor.h"
+#include "powersave.h"
+
+#define DEFAULT_DIM_FPS 1
+
+static volatile unsigned int *max_fps = NULL;
+
+/* Stage delays in nanoseconds, 0 if disabled. */
+static uint64_t dim_after = 0;
+static uint64_t blank_after = 0;
+static unsigned int dim_fps = DEFAULT_DIM_FPS;
+
+static unsigned int dim_timer = 0;
+static unsigned int blank_timer = 0;
+static bool blanked = false;
+
+static long long_from_env(const char *name, long fallback)
+{
+  const char *value = g_getenv(name);
+  char *end;
+  long n;
+
+  if (value == NULL || *value == '\0')
+    return fallback;
+
+  n = strtol(value, &end, 10);
+
+  if (*end != '\0' || n < 0)
+    return fallback;
+
+  return n;
+}
+
+void powersave_init(void)
+{
+  void *page;
+  long fps;
+
+  dim_after = long_from_env("VLOCK_SAVER_DIM_AFTER", 0) * 1000000000ULL;
+  blank_after = long_from_env("VLOCK_SAVER_BLANK_AFTER", 0) * 1000000000ULL;
+  fps = long_from_env("VLOCK_SAVER_DIM_FPS", DEFAULT_DIM_FPS);
+
+  /* The same range as the frame rates of src/overlay.c and
+   * modules/frame_clock.c. */
+  dim_fps = fps > 0 && fps <= 1000 ? (unsigned int) fps : DEFAULT_DIM_FPS;
+
+  if (dim_after == 0)
+    return;
+
+  page = mmap(NULL, sizeof *max_fps, PROT_READ | PROT_WRITE,
+              MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+  if (page == MAP_FAILED) {
+    g_warning("saver dimming disabled: %s", g_strerror(errno));
+    dim_after = 0;
+    return;
+  }
+
+  max_fps = page;
+  *max_fps = 0;
+}
+
+unsigned int powersave_max_fps(void)
+{
+  return max_fps != NULL ? *max_fps : 0;
+}
+
+static void dim(void *data)
+{
+  (void) data;
+
+  dim_timer = 0;
+  *max_fps = dim_fps;
+  g_debug("saver idle, limiting it to %u frames per second", dim_fps);
+}
+
+static bool blank_screen(bool blank)
+{
+#ifdef TIOCL_BLANKSCREEN
+  char arg[] = { blank ? TIOCL_BLANKSCREEN : TIOCL_UNBLANKSCREEN, 0 };
+
+  return ioctl(STDIN_FILENO, TIOCLINUX, arg) == 0;
+#else
+  (void) blank;
+  return false;
+#endif
+}
+
+static void blank(void *data)
+{
+  (void) data;
+
+  blank_timer = 0;
+  blanked = true;
+
+  supervisor_freeze();
+  plugins_pause_ticks();
+
+  /* Outside a virtual console the stopped saver just stays on the screen. */
+  if (!blank_screen(true))
+    g_debug("cannot blank the screen: %s", g_strerror(errno));
+  else
+    g_debug("saver idle, screen blanked");
+}
+
+void powersave_start(void)
+{
+  uint64_t now = monotonic_ns();
+
+  powersave_stop();
+
+  if (dim_after != 0)
+    dim_timer = events_add_timer(now + dim_after, dim, NULL);
+
+  if (blank_after != 0)
+    blank_timer = events_add_timer(now + blank_after, blank, NULL);
+}
+
+void powersave_stop(void)
+{
+  if (dim_timer != 0) {
+    events_remove_timer(dim_timer);
+    dim_timer = 0;
+  }
+
+  if (blank_timer != 0) {
+    events_remove_timer(blank_timer);
+    blank_timer = 0;
+  }
+
+  if (max_fps != NULL)
+    *max_fps = 0;
+
+  if (blanked) {
+    blanked = false;
+    (void) blank_screen(false);
+    plugins_resume_ticks();
+    supervisor_thaw();
+  }
+}
@@ -0,0 +1,30 @@
+/* powersave.h -- header file for the screen saver power stages of vlock,
+ *                the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#pragma once
+
+/* Read the stage timings from the environment and share the frame rate limit
+ * with the children.  Must be called before zygote_start(). */
+void powersave_init(void);
+
+/* The frame rate the screen savers are limited to, 0 if none. */
+unsigned int powersave_max_fps(void);
+
+/* Start the stages: after VLOCK_SAVER_DIM_AFTER seconds the savers' frame
+ * rate is limited to VLOCK_SAVER_DIM_FPS, after VLOCK_SAVER_BLANK_AFTER
+ * seconds they are stopped and the screen is blanked.  Called whenever the
+ * savers get the screen. */
+void powersave_start(void);
+
+/* Undo all stages and cancel the pending ones. */
+void powersave_stop(void);
@@ -11,70 +11,151 @@
  *
  */
 
+#if !defined(__FreeBSD__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
+#include <string.h>
 #include <signal.h>
+#include <spawn.h>
+#include <sched.h>
+#include <dirent.h>
 #include <sys/wait.h>
 #include <sys/resource.h>
-#include <sys/time.h>
+#include <sys/syscall.h>
 #include <fcntl.h>
-#include <sys/select.h>
+#include <poll.h>
+#include <time.h>
 #include <errno.h>
 
+#include "util.h"
 #include "process.h"
 
+/* posix_spawn_file_actions_addclosefrom_np() appeared in glibc 2.34.  Without
+ * it a spawned child would inherit all open file descriptors, so the fork()
+ * path is used instead. */
+#if defined(__GLIBC__) \
+  && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 34))
+#define HAVE_SPAWN_CLOSEFROM
+#endif
+
 GQuark vlock_process_error_quark(void)
 {
   return g_quark_from_static_string("vlock-process-error-quark");
 }
 
-/* Do nothing. */
-static void ignore_sigalarm(int __attribute__((unused)) signum)
+/* Reap the child if it has exited.  Returns 1 if it was reaped, 0 if it is
+ * still running and -1 on error. */
+static int try_reap(pid_t pid)
+{
+  int status;
+  pid_t result;
+
+  do
+    result = waitpid(pid, &status, WNOHANG);
+  while (result < 0 && errno == EINTR);
+
+  if (result < 0)
+    return -1;
+
+  return result == pid ? 1 : 0;
+}
+
+/* Wait for the child's pidfd to become readable, which happens when it
+ * exits.  The deadline is in monotonic nanoseconds, 0 means none.  Returns
+ * false if pidfds are not available. */
+static bool wait_pidfd(pid_t pid, uint64_t deadline)
+{
+#ifdef SYS_pidfd_open
+  int pidfd = syscall(SYS_pidfd_open, pid, 0);
+  struct pollfd pfd;
+
+  if (pidfd < 0)
+    return false;
+
+  pfd.fd = pidfd;
+  pfd.events = POLLIN;
+
+  for (;;) {
+    struct timespec remaining;
+    uint64_t now = monotonic_ns();
+    int result;
+
+    if (deadline != 0) {
+      if (now >= deadline)
+        break;
+
+      remaining.tv_sec = (deadline - now) / 1000000000;
+      remaining.tv_nsec = (deadline - now) % 1000000000;
+    }
+
+    result = ppoll(&pfd, 1, deadline != 0 ? &remaining : NULL, NULL);
+
+    /* Restart with the remaining time if interrupted by a signal. */
+    if (result >= 0 || errno != EINTR)
+      break;
+  }
+
+  (void) close(pidfd);
+
+  return true;
+#else
+  (void) pid;
+  (void) deadline;
+  return false;
+#endif
+}
+
+/* Poll for the death of the child with increasing intervals.  Used if
+ * pidfds are not available.  Returns true if the child was reaped. */
+static bool wait_polling(pid_t pid, uint64_t deadline)
 {
+  uint64_t interval = 100000;
+
+  for (;;) {
+    uint64_t now = monotonic_ns();
+    struct timespec ts;
+    int reaped = try_reap(pid);
+
+    if (reaped != 0)
+      return reaped > 0;
+
+    if (deadline != 0) {
+      if (now >= deadline)
+        return false;
+
+      if (interval > deadline - now)
+        interval = deadline - now;
+    }
+
+    ts.tv_sec = interval / 1000000000;
+    ts.tv_nsec = interval % 1000000000;
+    (void) nanosleep(&ts, NULL);
+
+    /* At most 10ms between checks. */
+    if (interval < 10000000)
+      interval *= 2;
+  }
 }
 
 bool wait_for_death(pid_t pid, long sec, long usec)
 {
-  int status;
-  struct sigaction act;
-  struct sigaction oldact;
-  struct itimerval timer;
-  struct itimerval otimer;
-  bool result;
-
-  /* Ignore SIGALRM.  The handler must be a real function instead of SIG_IGN
-   * otherwise waitpid() would not get interrupted.
-   *
-   * There is a small window here where a previously set alarm might be
-   * ignored.  */
-  sigemptyset(&act.sa_mask);
-  act.sa_handler = ignore_sigalarm;
-  act.sa_flags = 0;
-  sigaction(SIGALRM, &act, &oldact);
-
-  /* Initialize the timer. */
-  timer.it_value.tv_sec = sec;
-  timer.it_value.tv_usec = usec;
-  /* No repetition. */
-  timer.it_interval.tv_sec = 0;
-  timer.it_interval.tv_usec = 0;
-
-  /* Set the timer. */
-  setitimer(ITIMER_REAL, &timer, &otimer);
-
-  /* Wait until the child exits or the timer fires. */
-  result = (waitpid(pid, &status, 0) == pid);
-
-  /* Possible race condition.  If an alarm was set before it may get ignored.
-   * This is probably better than getting killed by our own alarm. */
-
-  /* Restore the timer. */
-  setitimer(ITIMER_REAL, &otimer, NULL);
-
-  /* Restore signal handler for SIGALRM. */
-  sigaction(SIGALRM, &oldact, NULL);
+  uint64_t timeout = (uint64_t) sec * 1000000000 + (uint64_t) usec * 1000;
+  uint64_t deadline = timeout != 0 ? monotonic_ns() + timeout : 0;
+  int reaped = try_reap(pid);
 
-  return result;
+  if (reaped != 0)
+    return reaped > 0;
+
+  /* The child is reaped as soon as it exits, no signals or timers are
+   * involved. */
+  if (!wait_pidfd(pid, deadline))
+    return wait_polling(pid, deadline);
+
+  return try_reap(pid) > 0;
 }
 
 /* Try hard to kill the given child process. */
@@ -97,7 +178,8 @@ void ensure_death(pid_t pid)
   /* Send SIGTERM. */
   (void) kill(pid, SIGTERM);
 
-  /* SIGTERM handler (if any) has 500ms to finish. */
+  /* SIGTERM handler (if any) has 500ms to finish.  Usually the child is gone
+   * much earlier. */
   if (wait_for_death(pid, 0, 500000L))
     return;
 
@@ -110,13 +192,66 @@ void ensure_death(pid_t pid)
   (void) waitpid(pid, &status, 0);
 }
 
-/* Close all possibly open file descriptors except the ones specified in the
- * given set. */
-static void close_fds(fd_set *except_fds)
+/* Close the file descriptors in the range [first, last] using close_range(2).
+ * Returns false if the kernel does not support it. */
+static bool close_range_fds(unsigned int first, unsigned int last)
+{
+#ifdef SYS_close_range
+  if (first > last)
+    return true;
+
+  return syscall(SYS_close_range, first, last, 0) == 0;
+#else
+  (void) first;
+  (void) last;
+  return false;
+#endif
+}
+
+/* Close the file descriptors listed in /proc/self/fd.  Returns false if the
+ * directory is not available. */
+static bool close_proc_fds(int keep_fd)
+{
+  DIR *dir = opendir("/proc/self/fd");
+  struct dirent *entry;
+
+  if (dir == NULL)
+    return false;
+
+  while ((entry = readdir(dir)) != NULL) {
+    char *end;
+    long fd = strtol(entry->d_name, &end, 10);
+
+    if (*entry->d_name == '\0' || *end != '\0')
+      continue;
+
+    if (fd > STDERR_FILENO && fd != keep_fd && fd != dirfd(dir))
+      (void) close(fd);
+  }
+
+  (void) closedir(dir);
+
+  return true;
+}
+
+/* Looping over every possible descriptor up to RLIMIT_NOFILE can take a
+ * million system calls, so that is only the last resort. */
+void close_fds(int keep_fd)
 {
   struct rlimit r;
   int maxfd;
 
+  if (keep_fd <= STDERR_FILENO) {
+    if (close_range_fds(STDERR_FILENO + 1, ~0U))
+      return;
+  } else if (close_range_fds(STDERR_FILENO + 1, keep_fd - 1)
+             && close_range_fds(keep_fd + 1, ~0U)) {
+    return;
+  }
+
+  if (close_proc_fds(keep_fd))
+    return;
+
   /* Get the maximum number of file descriptors. */
   if (getrlimit(RLIMIT_NOFILE, &r) == 0)
     maxfd = r.rlim_cur;
@@ -124,10 +259,8 @@ static void close_fds(fd_set *except_fds)
     /* Hopefully safe default. */
     maxfd = 1024;
 
-  /* Close all possibly open file descriptors except STDIN_FILENO,
-   * STDOUT_FILENO and STDERR_FILENO. */
-  for (int fd = 0; fd < maxfd; fd++)
-    if (!FD_ISSET(fd, except_fds))
+  for (int fd = STDERR_FILENO + 1; fd < maxfd; fd++)
+    if (fd != keep_fd)
       (void) close(fd);
 }
 
@@ -141,18 +274,324 @@ static int open_devnull(void)
   return devnull_fd;
 }
 
-bool create_child(struct child_process *child, GError **error)
+/* Parse a list of CPUs such as "0-3,6" into the given bitmap.  Returns false
+ * if the list is invalid. */
+static bool parse_cpus(const char *s, uint64_t cpus[RESOURCE_CPU_WORDS])
 {
-  int child_errno = 0;
-  int status_pipe[2];
-  int stdin_pipe[2];
-  int stdout_pipe[2];
-  int stderr_pipe[2];
+  uint64_t result[RESOURCE_CPU_WORDS] = { 0 };
+  const unsigned long max_cpu = RESOURCE_CPU_WORDS * 64 - 1;
+
+  while (*s != '\0') {
+    char *end;
+    unsigned long first = strtoul(s, &end, 10);
+    unsigned long last = first;
+
+    if (end == s)
+      return false;
 
-  if (pipe(status_pipe) < 0)
+    if (*end == '-') {
+      s = end + 1;
+      last = strtoul(s, &end, 10);
+
+      if (end == s)
+        return false;
+    }
+
+    if (first > last || last > max_cpu)
+      return false;
+
+    for (unsigned long cpu = first; cpu <= last; cpu++)
+      result[cpu / 64] |= UINT64_C(1) << (cpu % 64);
+
+    if (*end == ',')
+      end++;
+    else if (*end != '\0')
+      return false;
+
+    s = end;
+  }
+
+  memcpy(cpus, result, sizeof result);
+
+  return true;
+}
+
+/* Parse an I/O priority such as "idle", "be" or "be:7". */
+static bool parse_ioprio(const char *s, int *class, int *level)
+{
+  const char *colon = strchr(s, ':');
+  size_t length = colon != NULL ? (size_t) (colon - s) : strlen(s);
+  long l = 4;
+
+  if (colon != NULL) {
+    char *end;
+
+    l = strtol(colon + 1, &end, 10);
+
+    if (colon[1] == '\0' || *end != '\0' || l < 0 || l > 7)
+      return false;
+  }
+
+  if (length == 4 && strncmp(s, "idle", 4) == 0 && colon == NULL)
+    *class = 3;
+  else if (length == 2 && strncmp(s, "be", 2) == 0)
+    *class = 2;
+  else if (length == 2 && strncmp(s, "rt", 2) == 0)
+    *class = 1;
+  else
     return false;
 
-  (void) fcntl(status_pipe[1], F_SETFD, FD_CLOEXEC);
+  *level = *class == 3 ? 0 : l;
+
+  return true;
+}
+
+void resource_policy_from_env(const char *name, struct resource_policy *policy)
+{
+  const char *value;
+  char *end;
+
+  if ((value = plugin_getenv(name, "sched")) != NULL) {
+    if (strcmp(value, "other") == 0)
+      policy->sched = RESOURCE_SCHED_OTHER;
+    else if (strcmp(value, "batch") == 0)
+      policy->sched = RESOURCE_SCHED_BATCH;
+    else if (strcmp(value, "idle") == 0)
+      policy->sched = RESOURCE_SCHED_IDLE;
+    else
+      g_warning("%s: invalid scheduling class: %s", name, value);
+  }
+
+  if ((value = plugin_getenv(name, "nice")) != NULL) {
+    long nice = strtol(value, &end, 10);
+
+    if (*value != '\0' && *end == '\0' && nice >= -20 && nice <= 19) {
+      policy->set_nice = true;
+      policy->nice = nice;
+    } else {
+      g_warning("%s: invalid nice value: %s", name, value);
+    }
+  }
+
+  if ((value = plugin_getenv(name, "cpus")) != NULL)
+    if (!parse_cpus(value, policy->cpus))
+      g_warning("%s: invalid list of CPUs: %s", name, value);
+
+  if ((value = plugin_getenv(name, "ioprio")) != NULL)
+    if (!parse_ioprio(value, &policy->ioprio_class, &policy->ioprio_level))
+      g_warning("%s: invalid I/O priority: %s", name, value);
+
+  if ((value = plugin_getenv(name, "cpu_limit")) != NULL) {
+    unsigned long limit = strtoul(value, &end, 10);
+
+    if (*value != '\0' && *end == '\0')
+      policy->cpu_limit = limit;
+    else
+      g_warning("%s: invalid CPU time limit: %s", name, value);
+  }
+}
+
+/* Failures are ignored, the policy is a hint and the child should run
+ * anyway. */
+void apply_resource_policy(const struct resource_policy *policy)
+{
+  bool have_cpus = false;
+
+  if (policy->sched != RESOURCE_SCHED_KEEP) {
+    struct sched_param param = { .sched_priority = 0 };
+    int sched = SCHED_OTHER;
+
+#ifdef SCHED_BATCH
+    if (policy->sched == RESOURCE_SCHED_BATCH)
+      sched = SCHED_BATCH;
+#endif
+#ifdef SCHED_IDLE
+    if (policy->sched == RESOURCE_SCHED_IDLE)
+      sched = SCHED_IDLE;
+#endif
+
+    (void) sched_setscheduler(0, sched, &param);
+  }
+
+  if (policy->set_nice)
+    (void) setpriority(PRIO_PROCESS, 0, policy->nice);
+
+  for (size_t i = 0; i < RESOURCE_CPU_WORDS; i++)
+    if (policy->cpus[i] != 0)
+      have_cpus = true;
+
+#ifdef CPU_SETSIZE
+  if (have_cpus) {
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+
+    for (size_t cpu = 0; cpu < RESOURCE_CPU_WORDS * 64 && cpu < CPU_SETSIZE;
+         cpu++)
+      if (policy->cpus[cpu / 64] & (UINT64_C(1) << (cpu % 64)))
+        CPU_SET(cpu, &set);
+
+    (void) sched_setaffinity(0, sizeof set, &set);
+  }
+#else
+  (void) have_cpus;
+#endif
+
+#ifdef SYS_ioprio_set
+  if (policy->ioprio_class != 0)
+    /* IOPRIO_WHO_PROCESS, the class is stored above the 13 bits of data. */
+    (void) syscall(SYS_ioprio_set, 1, 0,
+                   (policy->ioprio_class << 13) | policy->ioprio_level);
+#endif
+
+  if (policy->cpu_limit != 0) {
+    /* SIGXCPU at the soft limit, SIGKILL a second later. */
+    struct rlimit r = {
+      .rlim_cur = policy->cpu_limit,
+      .rlim_max = policy->cpu_limit + 1,
+    };
+
+    (void) setrlimit(RLIMIT_CPU, &r);
+  }
+}
+
+void reset_signal_handlers(void)
+{
+  /* SIGINT is left alone, screen savers install their own handler for it
+   * before the child is created. */
+  static const int signals[] = { SIGQUIT, SIGTERM, SIGHUP, SIGABRT, SIGSEGV };
+
+  for (size_t i = 0; i < sizeof signals / sizeof signals[0]; i++) {
+    struct sigaction sa;
+
+    if (sigaction(signals[i], NULL, &sa) == 0 && sa.sa_handler != SIG_IGN
+        && sa.sa_handler != SIG_DFL) {
+      sa.sa_handler = SIG_DFL;
+      sa.sa_flags = 0;
+      (void) sigaction(signals[i], &sa, NULL);
+    }
+  }
+}
+
+/* Set up the given stdio descriptor of the child according to the
+ * corresponding field of the child struct.  pipe_fd is the child's end of the
+ * pipe if one was requested. */
+static void redirect_fd(int fd, int target, int pipe_fd)
+{
+  if (fd == REDIRECT_PIPE)
+    (void) dup2(pipe_fd, target);
+  else if (fd == REDIRECT_DEV_NULL)
+    (void) dup2(open_devnull(), target);
+  else if (fd != NO_REDIRECT)
+    (void) dup2(fd, target);
+}
+
+/* Run the child's function in a forked process.  Returns the child's errno
+ * (if it could not start) through the status pipe. */
+static void fork_child(struct child_process *child, int status_fd,
+                       int stdin_pipe[2], int stdout_pipe[2],
+                       int stderr_pipe[2])
+{
+  child->pid = fork();
+
+  if (child->pid != 0)
+    return;
+
+  /* Child. */
+  redirect_fd(child->stdin_fd, STDIN_FILENO, stdin_pipe[0]);
+  redirect_fd(child->stdout_fd, STDOUT_FILENO, stdout_pipe[1]);
+  redirect_fd(child->stderr_fd, STDERR_FILENO, stderr_pipe[1]);
+
+  close_fds(status_fd);
+
+  /* Drop privileges permanently.  vlock-main is setuid root, so if this
+   * fails we must abort instead of running the child with root privileges.
+   * setgid() must come before setuid(). */
+  if (setgid(getgid()) != 0 || setuid(getuid()) != 0)
+    _exit(1);
+
+  if (child->policy != NULL)
+    apply_resource_policy(child->policy);
+
+  if (child->function != NULL) {
+    (void) close(status_fd);
+    /* vlock's own handlers would run its atexit functions in the child. */
+    reset_signal_handlers();
+    _exit(child->function(child->argument));
+  } else {
+    execv(child->path, (char *const*) child->argv);
+    /* execv only returns on failure; report errno to the parent.  Nothing
+     * can be done if this write itself fails. */
+    ssize_t errno_written = write(status_fd, &errno, sizeof errno);
+    (void) errno_written;
+  }
+
+  _exit(1);
+}
+
+#ifdef HAVE_SPAWN_CLOSEFROM
+/* Add the file action for the given stdio descriptor of the child. */
+static int add_redirect(posix_spawn_file_actions_t *actions, int fd,
+                        int target, int pipe_fd)
+{
+  if (fd == REDIRECT_PIPE)
+    return posix_spawn_file_actions_adddup2(actions, pipe_fd, target);
+  else if (fd == REDIRECT_DEV_NULL)
+    return posix_spawn_file_actions_addopen(actions, target, "/dev/null",
+                                            O_RDWR, 0);
+  else if (fd != NO_REDIRECT)
+    return posix_spawn_file_actions_adddup2(actions, fd, target);
+  else
+    return 0;
+}
+
+/* Execute the child's program with posix_spawn().  The child is created
+ * without copying vlock-main's address space and exec errors are reported
+ * directly, without a status pipe.  Resetting the effective IDs before the
+ * exec drops privileges permanently, because exec copies them to the saved
+ * IDs.  Returns 0 on success or an error number. */
+static int spawn_child(struct child_process *child, int stdin_pipe[2],
+                       int stdout_pipe[2], int stderr_pipe[2])
+{
+  posix_spawn_file_actions_t actions;
+  posix_spawnattr_t attr;
+  int result;
+
+  if ((result = posix_spawn_file_actions_init(&actions)) != 0)
+    return result;
+
+  if ((result = posix_spawnattr_init(&attr)) != 0) {
+    (void) posix_spawn_file_actions_destroy(&actions);
+    return result;
+  }
+
+  if ((result = add_redirect(&actions, child->stdin_fd, STDIN_FILENO,
+                             stdin_pipe[0])) == 0
+      && (result = add_redirect(&actions, child->stdout_fd, STDOUT_FILENO,
+                                stdout_pipe[1])) == 0
+      && (result = add_redirect(&actions, child->stderr_fd, STDERR_FILENO,
+                                stderr_pipe[1])) == 0
+      && (result = posix_spawn_file_actions_addclosefrom_np(
+                       &actions, STDERR_FILENO + 1)) == 0
+      && (result = posix_spawnattr_setflags(&attr,
+                                            POSIX_SPAWN_RESETIDS)) == 0)
+    result = posix_spawn(&child->pid, child->path, &actions, &attr,
+                         (char *const*) child->argv, environ);
+
+  (void) posix_spawnattr_destroy(&attr);
+  (void) posix_spawn_file_actions_destroy(&actions);
+
+  return result;
+}
+#endif
+
+bool create_child(struct child_process *child, GError **error)
+{
+  int child_errno = 0;
+  int status_pipe[2] = { -1, -1 };
+  int stdin_pipe[2] = { -1, -1 };
+  int stdout_pipe[2] = { -1, -1 };
+  int stderr_pipe[2] = { -1, -1 };
 
   if (child->stdin_fd == REDIRECT_PIPE)
     if (pipe(stdin_pipe) < 0) {
@@ -184,60 +623,30 @@ bool create_child(struct child_process *child, GError **error)
       goto stderr_pipe_failed;
     }
 
-  child->pid = fork();
+#ifdef HAVE_SPAWN_CLOSEFROM
+  /* A resource policy has to be applied in a forked child. */
+  if (child->function == NULL && child->policy == NULL) {
+    child_errno = spawn_child(child, stdin_pipe, stdout_pipe, stderr_pipe);
 
-  if (child->pid == 0) {
-    /* Child. */
-    fd_set except_fds;
-
-    if (child->stdin_fd == REDIRECT_PIPE)
-      (void) dup2(stdin_pipe[0], STDIN_FILENO);
-    else if (child->stdin_fd == REDIRECT_DEV_NULL)
-      (void) dup2(open_devnull(), STDIN_FILENO);
-    else if (child->stdin_fd != NO_REDIRECT)
-      (void) dup2(child->stdin_fd, STDIN_FILENO);
-
-    if (child->stdout_fd == REDIRECT_PIPE)
-      (void) dup2(stdout_pipe[1], STDOUT_FILENO);
-    else if (child->stdout_fd == REDIRECT_DEV_NULL)
-      (void) dup2(open_devnull(), STDOUT_FILENO);
-    else if (child->stdout_fd != NO_REDIRECT)
-      (void) dup2(child->stdout_fd, STDOUT_FILENO);
-
-    if (child->stderr_fd == REDIRECT_PIPE)
-      (void) dup2(stderr_pipe[1], STDERR_FILENO);
-    else if (child->stderr_fd == REDIRECT_DEV_NULL)
-      (void) dup2(open_devnull(), STDERR_FILENO);
-    else if (child->stderr_fd != NO_REDIRECT)
-      (void) dup2(child->stderr_fd, STDERR_FILENO);
-
-    FD_ZERO(&except_fds);
-    FD_SET(STDIN_FILENO, &except_fds);
-    FD_SET(STDOUT_FILENO, &except_fds);
-    FD_SET(STDERR_FILENO, &except_fds);
-    FD_SET(status_pipe[1], &except_fds);
-
-    (void) close_fds(&except_fds);
-
-    /* Drop privileges permanently.  vlock-main is setuid root, so if this
-     * fails we must abort instead of running the child with root privileges.
-     * setgid() must come before setuid(). */
-    if (setgid(getgid()) != 0 || setuid(getuid()) != 0)
-      _exit(1);
-
-    if (child->function != NULL) {
-      (void) close(status_pipe[1]);
-      _exit(child->function(child->argument));
-    } else {
-      execv(child->path, (char *const*) child->argv);
-      /* execv only returns on failure; report errno to the parent.  Nothing
-       * can be done if this write itself fails. */
-      ssize_t errno_written = write(status_pipe[1], &errno, sizeof errno);
-      (void) errno_written;
-    }
+    if (child_errno != 0)
+      goto child_failed;
 
-    _exit(1);
+    goto child_started;
   }
+#endif
+
+  if (pipe(status_pipe) < 0) {
+    g_set_error(error,
+                VLOCK_PROCESS_ERROR,
+                VLOCK_PROCESS_ERROR_FAILED,
+                "could not open status pipe: %s",
+                g_strerror(errno));
+    goto status_pipe_failed;
+  }
+
+  (void) fcntl(status_pipe[1], F_SETFD, FD_CLOEXEC);
+
+  fork_child(child, status_pipe[1], stdin_pipe, stdout_pipe, stderr_pipe);
 
   if (child->pid < 0) {
     g_set_error(error,
@@ -249,22 +658,21 @@ bool create_child(struct child_process *child, GError **error)
   }
 
   (void) close(status_pipe[1]);
+  status_pipe[1] = -1;
 
   /* Get the error status from the child, if any. */
   if (read(status_pipe[0], &child_errno,
            sizeof child_errno) == sizeof child_errno) {
-    g_set_error(error,
-                VLOCK_PROCESS_ERROR,
-                child_errno == ENOENT ?
-                VLOCK_PROCESS_ERROR_NOT_FOUND :
-                VLOCK_PROCESS_ERROR_FAILED,
-                "child process could not exec: %s",
-                g_strerror(child_errno));
+    /* The child exits right after reporting. */
+    (void) waitpid(child->pid, NULL, 0);
     goto child_failed;
   }
 
   (void) close(status_pipe[0]);
 
+#ifdef HAVE_SPAWN_CLOSEFROM
+child_started:
+#endif
   if (child->stdin_fd == REDIRECT_PIPE) {
     /* Write end. */
     child->stdin_fd = stdin_pipe[1];
@@ -289,7 +697,22 @@ bool create_child(struct child_process *child, GError **error)
   return true;
 
 child_failed:
+  g_set_error(error,
+              VLOCK_PROCESS_ERROR,
+              child_errno == ENOENT ?
+              VLOCK_PROCESS_ERROR_NOT_FOUND :
+              VLOCK_PROCESS_ERROR_FAILED,
+              "child process could not exec: %s",
+              g_strerror(child_errno));
+
 fork_failed:
+  if (status_pipe[0] >= 0)
+    (void) close(status_pipe[0]);
+
+  if (status_pipe[1] >= 0)
+    (void) close(status_pipe[1]);
+
+status_pipe_failed:
   if (child->stderr_fd == REDIRECT_PIPE) {
     (void) close(stderr_pipe[0]);
     (void) close(stderr_pipe[1]);
@@ -308,9 +731,5 @@ stdout_pipe_failed:
   }
 
 stdin_pipe_failed:
-  (void) close(status_pipe[0]);
-  (void) close(status_pipe[1]);
-
   return false;
 }
-
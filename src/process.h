@@ -14,6 +14,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <sys/types.h>
 #include <glib.h>
 
@@ -28,12 +29,62 @@ enum {
 
 /* Wait for the given amount of time for the death of the given child process.
  * If the child process dies in the given amount of time or already was dead
- * true is returned and false otherwise. */
+ * true is returned and false otherwise.  The child is reaped.  A time of 0
+ * waits until the child dies. */
 bool wait_for_death(pid_t pid, long sec, long usec);
 
 /* Try hard to kill the given child process. */
 void ensure_death(pid_t pid);
 
+/* Scheduling classes for a resource policy. */
+enum {
+  RESOURCE_SCHED_KEEP,
+  RESOURCE_SCHED_OTHER,
+  RESOURCE_SCHED_BATCH,
+  RESOURCE_SCHED_IDLE,
+};
+
+#define RESOURCE_CPU_WORDS 16
+
+/* Resources a child process may use.  They are applied after privileges
+ * were dropped, so they can only lower the child's share of the machine.
+ * Zeroed fields leave the respective setting alone. */
+struct resource_policy
+{
+  /* One of the RESOURCE_SCHED_* values. */
+  int sched;
+  /* Nice value, if set_nice is true. */
+  bool set_nice;
+  int nice;
+  /* Bitmap of CPUs the child may run on, 64 per word. */
+  uint64_t cpus[RESOURCE_CPU_WORDS];
+  /* I/O priority class (1 realtime, 2 best-effort, 3 idle) and level. */
+  int ioprio_class;
+  int ioprio_level;
+  /* Limit of CPU time in seconds. */
+  unsigned long cpu_limit;
+};
+
+/* Read the resource policy of the plugin with the given name from the
+ * environment variables VLOCK_<NAME>_SCHED (other, batch or idle),
+ * VLOCK_<NAME>_NICE, VLOCK_<NAME>_CPUS (e.g. "0-3,6"), VLOCK_<NAME>_IOPRIO
+ * (idle, or be or rt followed by an optional ":<level>") and
+ * VLOCK_<NAME>_CPU_LIMIT (seconds).  Settings that are not set or invalid
+ * keep the value they had in the given policy. */
+void resource_policy_from_env(const char *name,
+                              struct resource_policy *policy);
+
+/* Apply the given resource policy to the calling process. */
+void apply_resource_policy(const struct resource_policy *policy);
+
+/* Close all possibly open file descriptors except stdin, stdout, stderr and
+ * the given one (if not negative). */
+void close_fds(int keep_fd);
+
+/* Restore the default action of the termination signals that vlock-main
+ * handles.  Used in child processes that do not exec. */
+void reset_signal_handlers(void);
+
 #define NO_REDIRECT (-2)
 #define REDIRECT_DEV_NULL (-3)
 #define REDIRECT_PIPE (-4)
@@ -54,15 +105,25 @@ struct child_process
   int stdout_fd;
   /* The child's stderr. */
   int stderr_fd;
+  /* Resource policy of the child, or NULL. */
+  const struct resource_policy *policy;
+  /* The child may be started by the zygote (see zygote.h) instead of
+   * vlock-main.  Only for a function that does not depend on anything set up
+   * after the vlock_start hooks (such as the screen) and an argument that is
+   * valid since then, too.  The child must not inherit stdio other than
+   * vlock-main's own: each stdio field has to be NO_REDIRECT or
+   * REDIRECT_DEV_NULL. */
+  bool zygote_safe;
   /* The child's PID. */
   pid_t pid;
 };
 
 /* Create a new child process.  All file descriptors except stdin, stdout and
  * stderr are closed and privileges are dropped.  All fields of the child
- * struct except pid must be set.  If a stdio file descriptor field has the
- * special value of REDIRECT_DEV_NULL it is redirected from or to /dev/null.
- * If it has the value REDIRECT_PIPE a pipe will be created and one end will be
+ * struct except pid, policy and zygote_safe must be set; zygote_safe is only
+ * read by zygote_spawn().  If a stdio file descriptor field has the special
+ * value of REDIRECT_DEV_NULL it is redirected from or to /dev/null.  If it has
+ * the value REDIRECT_PIPE a pipe will be created and one end will be
  * connected to the respective descriptor of the child.  The file descriptor of
  * the other end is stored in the field after the call.  It is up to the caller
  * to close the pipe descriptor(s). */
@@ -0,0 +1,203 @@
+/* profile.c -- hook profiler for vlock, the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* Every hook call made through plugins.c is timed and accounted to its
+ * (plugin, hook) pair.  Besides call count, total and maximum time each pair
+ * keeps a histogram with power-of-two buckets in microseconds, so slow
+ * outliers on a particular host stand out from the average. */
+
+#if !defined(__FreeBSD__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <glib.h>
+
+#include "profile.h"
+
+/* Bucket i counts calls that took less than 2^i microseconds (and at least
+ * 2^(i-1)), the last bucket takes everything slower. */
+#define NR_BUCKETS 24
+
+struct profile_entry
+{
+  char *plugin_name;
+  const char *hook_name;
+  unsigned int calls;
+  uint64_t total_ns;
+  uint64_t max_ns;
+  unsigned int histogram[NR_BUCKETS];
+};
+
+static GList *entries = NULL;
+
+static struct profile_entry *get_entry(const char *plugin_name,
+                                       const char *hook_name)
+{
+  struct profile_entry *e;
+
+  for (GList *item = entries; item != NULL; item = g_list_next(item)) {
+    e = item->data;
+
+    if (strcmp(e->hook_name, hook_name) == 0
+        && strcmp(e->plugin_name, plugin_name) == 0)
+      return e;
+  }
+
+  e = g_malloc0(sizeof *e);
+  e->plugin_name = g_strdup(plugin_name);
+  /* Hook names are static strings from the hooks table. */
+  e->hook_name = hook_name;
+
+  entries = g_list_append(entries, e);
+
+  return e;
+}
+
+void profile_record(const char *plugin_name, const char *hook_name,
+                    uint64_t elapsed_ns)
+{
+  struct profile_entry *e = get_entry(plugin_name, hook_name);
+  uint64_t us = elapsed_ns / 1000;
+  size_t bucket = 0;
+
+  e->calls++;
+  e->total_ns += elapsed_ns;
+
+  if (elapsed_ns > e->max_ns)
+    e->max_ns = elapsed_ns;
+
+  while (us > 0 && bucket < NR_BUCKETS - 1) {
+    us >>= 1;
+    bucket++;
+  }
+
+  e->histogram[bucket]++;
+}
+
+/* Slowest first. */
+static gint compare_total(gconstpointer a, gconstpointer b)
+{
+  const struct profile_entry *x = a;
+  const struct profile_entry *y = b;
+
+  if (x->total_ns != y->total_ns)
+    return x->total_ns < y->total_ns ? 1 : -1;
+
+  return strcmp(x->plugin_name, y->plugin_name);
+}
+
+/* Format one entry as two lines, the numbers and the histogram. */
+static char *format_entry(const struct profile_entry *e)
+{
+  GString *s = g_string_new(NULL);
+
+  g_string_append_printf(s, "%-16s %-18s %6u %12.3f %10.3f %10.3f\n   ",
+                         e->plugin_name, e->hook_name, e->calls,
+                         e->total_ns / 1e6,
+                         e->total_ns / 1e6 / e->calls,
+                         e->max_ns / 1e6);
+
+  for (size_t i = 0; i < NR_BUCKETS; i++) {
+    if (e->histogram[i] == 0)
+      continue;
+
+    if (i == NR_BUCKETS - 1)
+      g_string_append_printf(s, " >=%luus:%u", 1UL << (i - 1), e->histogram[i]);
+    else
+      g_string_append_printf(s, " <%luus:%u", 1UL << i, e->histogram[i]);
+  }
+
+  return g_string_free(s, false);
+}
+
+/* Open the report destination named by VLOCK_PROFILE, if any.  Files are
+ * opened with the invoking user's privileges because vlock-main runs setuid
+ * root. */
+static FILE *open_report(void)
+{
+  const char *target = g_getenv("VLOCK_PROFILE");
+  FILE *f;
+  uid_t euid;
+  gid_t egid;
+
+  if (target == NULL || *target == '\0')
+    return NULL;
+
+  if (strcmp(target, "1") == 0 || strcmp(target, "yes") == 0
+      || strcmp(target, "true") == 0 || strcmp(target, "stderr") == 0)
+    return stderr;
+
+  euid = geteuid();
+  egid = getegid();
+
+  if (setegid(getgid()) != 0 || seteuid(getuid()) != 0) {
+    fprintf(stderr, "vlock: could not drop privileges for the profile: %s\n",
+            g_strerror(errno));
+    return NULL;
+  }
+
+  f = fopen(target, "w");
+
+  if (f == NULL)
+    fprintf(stderr, "vlock: could not open profile file %s: %s\n",
+            target, g_strerror(errno));
+
+  /* Regain privileges through the saved set-user-ID. */
+  if (seteuid(euid) != 0 || setegid(egid) != 0)
+    abort();
+
+  return f;
+}
+
+void profile_report(void)
+{
+  static const char *header =
+    "plugin           hook                calls     total ms     avg ms     max ms";
+  FILE *f;
+
+  if (entries == NULL)
+    return;
+
+  entries = g_list_sort(entries, compare_total);
+
+  f = open_report();
+
+  g_debug("hook profile, sorted by total time:");
+  g_debug("%s", header);
+
+  if (f != NULL)
+    fprintf(f, "vlock hook profile, sorted by total time:\n%s\n", header);
+
+  while (entries != NULL) {
+    struct profile_entry *e = entries->data;
+    char *line = format_entry(e);
+
+    g_debug("%s", line);
+
+    if (f != NULL)
+      fprintf(f, "%s\n", line);
+
+    g_free(line);
+    g_free(e->plugin_name);
+    g_free(e);
+    entries = g_list_delete_link(entries, entries);
+  }
+
+  if (f != NULL && f != stderr)
+    (void) fclose(f);
+}
@@ -0,0 +1,26 @@
+/* profile.h -- header file for the hook profiler of vlock,
+ *              the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/* Record that the given hook of the given plugin took the given number of
+ * nanoseconds. */
+void profile_record(const char *plugin_name, const char *hook_name,
+                    uint64_t elapsed_ns);
+
+/* Write the collected timings, sorted by total time, to the debug log.  If
+ * VLOCK_PROFILE is set the report is also written to stderr (if the value is
+ * "1", "yes", "true" or "stderr") or else to the file it names. */
+void profile_report(void);
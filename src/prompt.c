@@ -51,6 +51,8 @@
 
 #include <glib.h>
 
+#include "util.h"
+#include "events.h"
 #include "prompt.h"
 
 #define PROMPT_BUFFER_SIZE 512
@@ -161,55 +163,71 @@ char *prompt_echo_off(const char *msg,
 }
 
 /* Read a single character from the stdin.  If the timeout is reached
- * 0 is returned. */
+ * 0 is returned.  Event sources (see events.h) are serviced while waiting. */
 char read_character(const struct timespec *timeout, GError **error)
 {
   char c = 0;
-  struct timeval *timeout_val = NULL;
+  uint64_t deadline = 0;
   fd_set readfds;
 
   g_assert(error == NULL || *error == NULL);
 
-before_select:
-  if (timeout != NULL) {
-    timeout_val = calloc(1, sizeof *timeout_val);
+  if (timeout != NULL)
+    deadline = monotonic_ns() + (uint64_t) timeout->tv_sec * 1000000000
+               + timeout->tv_nsec;
 
-    if (timeout_val != NULL) {
-      timeout_val->tv_sec = timeout->tv_sec;
-      timeout_val->tv_usec = timeout->tv_nsec / 1000;
+  for (;;) {
+    struct timeval timeout_val;
+    uint64_t wakeup = deadline;
+    int maxfd;
+    int result;
+
+    /* Initialize file descriptor set. */
+    FD_ZERO(&readfds);
+    FD_SET(STDIN_FILENO, &readfds);
+    maxfd = events_prepare(&readfds, STDIN_FILENO, &wakeup);
+
+    if (wakeup != 0) {
+      uint64_t now = monotonic_ns();
+      uint64_t remaining = wakeup > now ? wakeup - now : 0;
+
+      /* Round up so the deadline has passed when select() returns. */
+      remaining += 999;
+      timeout_val.tv_sec = remaining / 1000000000;
+      timeout_val.tv_usec = (remaining % 1000000000) / 1000;
     }
-  }
-
-  /* Initialize file descriptor set. */
-  FD_ZERO(&readfds);
-  FD_SET(STDIN_FILENO, &readfds);
 
-  /* Reset errno. */
-  errno = 0;
+    /* Wait for a character. */
+    result = select(maxfd + 1, &readfds, NULL, NULL,
+                    wakeup != 0 ? &timeout_val : NULL);
 
-  /* Wait for a character. */
-  if (select(STDIN_FILENO + 1, &readfds, NULL, NULL, timeout_val) != 1) {
-    switch (errno) {
-      case EINTR:
+    if (result < 0) {
+      if (errno == EINTR)
 	/* A signal was caught.  Restart. */
-	free(timeout_val);
-	goto before_select;
-      case 0:
-	/* Timeout was hit. */
-	g_propagate_error(error,
-			  g_error_new_literal(
-                            VLOCK_PROMPT_ERROR,
-			    VLOCK_PROMPT_ERROR_TIMEOUT,
-			    ""));
-	goto out;
-      default:
-	/* Some other error. */
-	g_propagate_error(error,
-			  g_error_new_literal(
-                            VLOCK_PROMPT_ERROR,
-			    VLOCK_PROMPT_ERROR_FAILED,
-			    g_strerror(errno)));
-	goto out;
+	continue;
+
+      /* Some other error. */
+      g_propagate_error(error,
+                        g_error_new_literal(
+                          VLOCK_PROMPT_ERROR,
+                          VLOCK_PROMPT_ERROR_FAILED,
+                          g_strerror(errno)));
+      return 0;
+    }
+
+    events_dispatch(&readfds);
+
+    if (FD_ISSET(STDIN_FILENO, &readfds))
+      break;
+
+    if (deadline != 0 && monotonic_ns() >= deadline) {
+      /* Timeout was hit. */
+      g_propagate_error(error,
+                        g_error_new_literal(
+                          VLOCK_PROMPT_ERROR,
+                          VLOCK_PROMPT_ERROR_TIMEOUT,
+                          ""));
+      return 0;
     }
   }
 
@@ -218,8 +236,6 @@ before_select:
   if (read(STDIN_FILENO, &c, 1) != 1)
     c = 0;
 
-out:
-  free(timeout_val);
   return c;
 }
 
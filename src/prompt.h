@@ -64,7 +64,7 @@ char *prompt_echo_off(const char *msg,
                       GError **error);
 
 /* Read a single character from the stdin.  If the timeout is reached
- * 0 is returned. */
+ * 0 is returned.  Event sources (see events.h) are serviced while waiting. */
 char read_character(const struct timespec *timeout, GError **error);
 
 /* Wait for any of the characters in the given character set to be read from
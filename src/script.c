@@ -21,9 +21,16 @@
  * argument.  It should not exit until its stdin closes.  The hook that should
  * be executed is written to its stdin on a single line.
  *
- * Currently there is no way for a script to communicate errors or even success
- * to vlock.  If it exits it will linger as a zombie until the plugin is
+ * By default there is no way for a script to communicate errors or even
+ * success to vlock.  If it exits it will linger as a zombie until the plugin is
  * destroyed.
+ *
+ * Scripts may opt in to protocol version 2 by setting VLOCK_<NAME>_PROTOCOL to
+ * "2" (modules.<name>.protocol in the config file).  In that case the script's
+ * stdout is connected to a pipe as well and the script must answer every hook
+ * with a single line, either "ok <hook>" or "error <hook> <message>".  vlock
+ * waits for that answer up to a deadline (VLOCK_<NAME>_HOOK_TIMEOUT or
+ * VLOCK_<NAME>_<HOOK>_TIMEOUT milliseconds) before the next plugin is run.
  */
 
 #if !defined(__FreeBSD__) && !defined(_GNU_SOURCE)
@@ -36,16 +43,19 @@
 #include <unistd.h>
 #include <limits.h>
 #include <sys/select.h>
+#include <poll.h>
 #include <fcntl.h>
 #include <signal.h>
 #include <errno.h>
 #include <sys/time.h>
 #include <time.h>
+#include <stdint.h>
 
 #include <glib.h>
 #include <glib-object.h>
 
 #include "process.h"
+#include "supervisor.h"
 #include "util.h"
 
 #include "plugin.h"
@@ -212,6 +222,17 @@ static void parse_dependency(char *data, GList **dependency_list)
   g_strfreev(dependency_items);
 }
 
+/* Default deadline for protocol version 2 acknowledgements. */
+#define DEFAULT_HOOK_TIMEOUT_MS 5000
+
+/* Completion latency of one hook, protocol version 2 only. */
+struct hook_latency
+{
+  unsigned int count;
+  uint64_t total_ns;
+  uint64_t max_ns;
+};
+
 struct _VlockScriptPrivate
 {
   /* The path to the script. */
@@ -224,6 +245,18 @@ struct _VlockScriptPrivate
   int fd;
   /* The PID of the script. */
   pid_t pid;
+  /* Hook protocol version, 1 or 2. */
+  int protocol;
+  /* The pipe file descriptor that is connected to the script's stdout.  Only
+   * used with protocol version 2. */
+  int reply_fd;
+  /* Partial reply line read from reply_fd. */
+  char reply[LINE_MAX];
+  size_t reply_length;
+  /* Acknowledgement deadline for each hook in milliseconds. */
+  long hook_timeouts[nr_hooks];
+  /* Completion latency for each hook. */
+  struct hook_latency latency[nr_hooks];
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE(VlockScript, vlock_script, TYPE_VLOCK_PLUGIN)
@@ -236,6 +269,16 @@ static void vlock_script_init(VlockScript *self)
   self->priv->dead = false;
   self->priv->launched = false;
   self->priv->path = NULL;
+  self->priv->protocol = 1;
+  self->priv->reply_fd = -1;
+  self->priv->reply_length = 0;
+
+  for (size_t i = 0; i < nr_hooks; i++) {
+    self->priv->hook_timeouts[i] = DEFAULT_HOOK_TIMEOUT_MS;
+    self->priv->latency[i].count = 0;
+    self->priv->latency[i].total_ns = 0;
+    self->priv->latency[i].max_ns = 0;
+  }
 }
 
 static void vlock_script_finalize(GObject *object)
@@ -244,11 +287,25 @@ static void vlock_script_finalize(GObject *object)
 
   g_free(self->priv->path);
 
+  for (size_t i = 0; i < nr_hooks; i++) {
+    struct hook_latency *l = &self->priv->latency[i];
+
+    if (l->count > 0)
+      g_debug("script '%s': %s acknowledged %u times, avg %.3f ms, max %.3f ms",
+              VLOCK_PLUGIN(self)->name, hooks[i].name, l->count,
+              l->total_ns / 1e6 / l->count, l->max_ns / 1e6);
+  }
+
   if (self->priv->launched) {
-    /* Close the pipe. */
+    /* Close the pipes. */
     (void) close(self->priv->fd);
 
+    if (self->priv->reply_fd >= 0)
+      (void) close(self->priv->reply_fd);
+
     /* Kill the child process. */
+    supervisor_forget(self->priv->pid);
+
     if (!wait_for_death(self->priv->pid, 0, 500000L))
       ensure_death(self->priv->pid);
   }
@@ -256,6 +313,44 @@ static void vlock_script_finalize(GObject *object)
   G_OBJECT_CLASS(vlock_script_parent_class)->finalize(object);
 }
 
+/* Parse a positive number of milliseconds.  Returns the fallback if the string
+ * is NULL or invalid. */
+static long parse_milliseconds(const char *s, long fallback)
+{
+  char *end;
+  long ms;
+
+  if (s == NULL)
+    return fallback;
+
+  ms = strtol(s, &end, 10);
+
+  if (*end != '\0' || ms <= 0)
+    return fallback;
+
+  return ms;
+}
+
+/* Read the protocol version and the hook deadlines from the environment. */
+static void vlock_script_configure(VlockScript *self)
+{
+  const char *name = VLOCK_PLUGIN(self)->name;
+  const char *protocol = plugin_getenv(name, "protocol");
+  long timeout = parse_milliseconds(plugin_getenv(name, "hook_timeout"),
+                                    DEFAULT_HOOK_TIMEOUT_MS);
+
+  if (protocol != NULL && strcmp(protocol, "2") == 0)
+    self->priv->protocol = 2;
+
+  for (size_t i = 0; i < nr_hooks; i++) {
+    char *key = g_strdup_printf("%s_timeout", hooks[i].name);
+
+    self->priv->hook_timeouts[i] = parse_milliseconds(plugin_getenv(name, key),
+                                                      timeout);
+    g_free(key);
+  }
+}
+
 static bool vlock_script_open(VlockPlugin *plugin, GError **error)
 {
   GError *tmp_error = NULL;
@@ -263,6 +358,8 @@ static bool vlock_script_open(VlockPlugin *plugin, GError **error)
 
   self->priv->path = g_strdup_printf("%s/%s", VLOCK_SCRIPT_DIR, plugin->name);
 
+  vlock_script_configure(self);
+
   /* Get the dependency information.  Whether the script is executable or not
    * is also detected here. */
   for (size_t i = 0; i < nr_dependencies; i++)
@@ -298,7 +395,12 @@ static bool vlock_script_launch(VlockScript *script, GError **error)
     .function = NULL,
   };
 
-  if (!create_child(&child, &tmp_error)) {
+  /* Protocol version 2 scripts answer through their stdout. */
+  if (script->priv->protocol == 2)
+    child.stdout_fd = REDIRECT_PIPE;
+
+  if (!supervisor_spawn(VLOCK_PLUGIN(script)->name, &child, false,
+                        &tmp_error)) {
     g_propagate_error(error, tmp_error);
     return false;
   }
@@ -313,9 +415,162 @@ static bool vlock_script_launch(VlockScript *script, GError **error)
     (void) fcntl(script->priv->fd, F_SETFL, fd_flags);
   }
 
+  if (script->priv->protocol == 2) {
+    script->priv->reply_fd = child.stdout_fd;
+
+    fd_flags = fcntl(script->priv->reply_fd, F_GETFL);
+
+    if (fd_flags != -1)
+      (void) fcntl(script->priv->reply_fd, F_SETFL, fd_flags | O_NONBLOCK);
+  }
+
   return true;
 }
 
+/* Check one reply line against the given hook.  Returns 1 for "ok", 0 for
+ * "error" and -1 if the line does not answer this hook, e.g. a late answer to
+ * a hook whose deadline already passed or one without a hook name. */
+static int parse_reply(VlockScript *self, char *line, const char *hook_name)
+{
+  char *status = line;
+  char *name;
+  char *message;
+
+  name = strchr(line, ' ');
+
+  if (name != NULL) {
+    *name++ = '\0';
+    message = strchr(name, ' ');
+
+    if (message != NULL)
+      *message++ = '\0';
+  } else {
+    message = NULL;
+  }
+
+  /* A bare status could be a late answer to an earlier hook. */
+  if (name == NULL || strcmp(name, hook_name) != 0)
+    return -1;
+
+  if (strcmp(status, "ok") == 0)
+    return 1;
+
+  if (strcmp(status, "error") == 0) {
+    fprintf(stderr, "vlock: script '%s' failed in %s: %s\n",
+            VLOCK_PLUGIN(self)->name, hook_name,
+            message != NULL ? message : "unknown error");
+    return 0;
+  }
+
+  return -1;
+}
+
+/* Drop the replies that arrived after their deadline, so they cannot be taken
+ * for answers to the next hook. */
+static void discard_replies(VlockScriptPrivate *priv)
+{
+  struct pollfd pfd = { .fd = priv->reply_fd, .events = POLLIN };
+  char buffer[LINE_MAX];
+
+  while (poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN) != 0
+         && read(priv->reply_fd, buffer, sizeof buffer) > 0)
+    ;
+
+  priv->reply_length = 0;
+}
+
+/* Wait until the script acknowledges the given hook or the hook's deadline
+ * passes.  Returns true if the script answered "ok".  Otherwise errno is 0
+ * if it answered "error", ETIMEDOUT if the deadline passed and EPIPE if the
+ * script went away. */
+static bool wait_for_reply(VlockScript *self, size_t hook_index)
+{
+  VlockScriptPrivate *priv = self->priv;
+  const char *hook_name = hooks[hook_index].name;
+  uint64_t start = monotonic_ns();
+  uint64_t deadline = start + (uint64_t) priv->hook_timeouts[hook_index] * 1000000ULL;
+
+  for (;;) {
+    char *newline;
+
+    /* Process complete lines already in the buffer. */
+    while ((newline = memchr(priv->reply, '\n', priv->reply_length)) != NULL) {
+      size_t line_length = newline - priv->reply + 1;
+      int result;
+
+      *newline = '\0';
+      result = parse_reply(self, priv->reply, hook_name);
+
+      priv->reply_length -= line_length;
+      memmove(priv->reply, priv->reply + line_length, priv->reply_length);
+
+      if (result >= 0) {
+        struct hook_latency *l = &priv->latency[hook_index];
+        uint64_t elapsed = monotonic_ns() - start;
+
+        l->count++;
+        l->total_ns += elapsed;
+
+        if (elapsed > l->max_ns)
+          l->max_ns = elapsed;
+
+        g_debug("script '%s': %s acknowledged after %.3f ms",
+                VLOCK_PLUGIN(self)->name, hook_name, elapsed / 1e6);
+
+        /* The script's message was printed already. */
+        errno = 0;
+        return result == 1;
+      }
+    }
+
+    /* Drop overlong lines instead of waiting forever for their end. */
+    if (priv->reply_length == sizeof priv->reply)
+      priv->reply_length = 0;
+
+    uint64_t now = monotonic_ns();
+
+    if (now >= deadline) {
+      fprintf(stderr, "vlock: script '%s' did not acknowledge %s within %ld ms\n",
+              VLOCK_PLUGIN(self)->name, hook_name,
+              priv->hook_timeouts[hook_index]);
+      errno = ETIMEDOUT;
+      return false;
+    }
+
+    struct pollfd pfd = { .fd = priv->reply_fd, .events = POLLIN };
+    /* Round up so a sub-millisecond remainder does not spin. */
+    int timeout = (int) ((deadline - now + 999999) / 1000000);
+
+    if (poll(&pfd, 1, timeout) < 0) {
+      if (errno == EINTR)
+        continue;
+
+      return false;
+    }
+
+    if (pfd.revents == 0)
+      continue;
+
+    ssize_t length = read(priv->reply_fd,
+                          priv->reply + priv->reply_length,
+                          sizeof priv->reply - priv->reply_length);
+
+    if (length < 0 && (errno == EAGAIN || errno == EINTR))
+      continue;
+
+    if (length <= 0) {
+      /* The script closed its stdout or exited. */
+      if (length == 0)
+        errno = EPIPE;
+
+      priv->dead = true;
+      return false;
+    }
+
+    priv->reply_length += length;
+  }
+}
+
 static bool vlock_script_call_hook(VlockPlugin *plugin, const gchar *hook_name)
 {
   VlockScript *self = VLOCK_SCRIPT(plugin);
@@ -347,6 +602,9 @@ static bool vlock_script_call_hook(VlockPlugin *plugin, const gchar *hook_name)
   act.sa_handler = SIG_IGN;
   (void) sigaction(SIGPIPE, &act, &oldact);
 
+  if (self->priv->protocol == 2)
+    discard_replies(self->priv);
+
   /* Send hook name and a newline through the pipe. */
   length = write(self->priv->fd, hook_name, hook_name_length);
 
@@ -359,7 +617,16 @@ static bool vlock_script_call_hook(VlockPlugin *plugin, const gchar *hook_name)
   /* If write fails the script is considered dead. */
   self->priv->dead = (length != hook_name_length + 1);
 
-  return !self->priv->dead;
+  if (self->priv->dead)
+    return false;
+
+  if (self->priv->protocol == 2) {
+    for (size_t i = 0; i < nr_hooks; i++)
+      if (strcmp(hooks[i].name, hook_name) == 0)
+        return wait_for_reply(self, i);
+  }
+
+  return true;
 }
 
 /* Initialize script class. */
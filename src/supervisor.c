@@ -0,0 +1,581 @@
+/* supervisor.c -- child supervisor for vlock,
+ *                 the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* Screen savers and scripts run in child processes.  The supervisor watches
+ * each of them through a pidfd that is serviced by the event loop while vlock
+ * waits for input.  A screen saver that crashes is restarted after a delay
+ * that doubles with each crash in a row, so that a broken saver does not
+ * leave a frozen screen behind and does not spin either.  After too many
+ * crashes in a row it is given up. */
+
+#if !defined(__FreeBSD__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <sys/syscall.h>
+
+#include <glib.h>
+
+#include "util.h"
+#include "events.h"
+#include "zygote.h"
+#include "supervisor.h"
+
+/* First restart delay, doubled for every further crash in a row. */
+#define RESTART_DELAY_MS 100
+#define MAX_RESTART_DELAY_MS 5000
+
+/* A child that ran this long before dying did not crash "in a row". */
+#define STABLE_UPTIME_MS 10000
+
+/* Default number of crashes in a row after which a child is given up. */
+#define DEFAULT_MAX_RESTARTS 5
+
+/* Default time in seconds a suspended child is kept for resuming. */
+#define DEFAULT_WARM_SECONDS 300
+
+/* Time the children get at teardown after their stdin was closed or they
+ * were sent SIGTERM. */
+#define TEARDOWN_GRACE_MS 500
+
+struct supervised_child
+{
+  char *name;
+  /* The caller's struct, only kept for children that are restarted. */
+  struct child_process *child;
+  /* The parameters the child was created with. */
+  struct child_process template;
+  pid_t pid;
+  /* False once the supervisor reaped the child. */
+  bool alive;
+  /* The caller's end of the child's stdin pipe, -1 if none. */
+  int stdin_fd;
+  /* -1 if not watched. */
+  int pidfd;
+  bool restart;
+  /* Monotonic time of the last (re)start. */
+  uint64_t started;
+  unsigned int restarts;
+  /* Crashes since the child last ran for STABLE_UPTIME_MS. */
+  unsigned int failures;
+  /* Pending restart, 0 if none. */
+  unsigned int restart_timer;
+  /* Stopped by supervisor_suspend(), and when. */
+  bool suspended;
+  uint64_t suspended_at;
+  /* Kills the suspended child when it was not resumed in time, 0 if none. */
+  unsigned int cold_timer;
+  /* Stopped by supervisor_freeze(). */
+  bool frozen;
+};
+
+static GList *children = NULL;
+
+static int open_pidfd(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+  return syscall(SYS_pidfd_open, pid, 0);
+#else
+  (void) pid;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+static unsigned int max_restarts(void)
+{
+  const char *value = g_getenv("VLOCK_SAVER_RESTARTS");
+  char *end;
+  long n;
+
+  if (value == NULL || *value == '\0')
+    return DEFAULT_MAX_RESTARTS;
+
+  n = strtol(value, &end, 10);
+
+  if (*end != '\0' || n < 0)
+    return DEFAULT_MAX_RESTARTS;
+
+  return n;
+}
+
+/* Time in nanoseconds a suspended child is kept, 0 meaning not at all. */
+static uint64_t warm_time(void)
+{
+  const char *value = g_getenv("VLOCK_SAVER_WARM");
+  char *end;
+  long seconds;
+
+  if (value == NULL || *value == '\0')
+    return DEFAULT_WARM_SECONDS * 1000000000ULL;
+
+  seconds = strtol(value, &end, 10);
+
+  if (*end != '\0' || seconds < 0)
+    return DEFAULT_WARM_SECONDS * 1000000000ULL;
+
+  return seconds * 1000000000ULL;
+}
+
+static struct supervised_child *find_child(pid_t pid)
+{
+  for (GList *item = children; item != NULL; item = g_list_next(item)) {
+    struct supervised_child *c = item->data;
+
+    if (c->pid == pid)
+      return c;
+  }
+
+  return NULL;
+}
+
+static void unwatch(struct supervised_child *c)
+{
+  if (c->pidfd >= 0) {
+    events_remove_fd(c->pidfd);
+    (void) close(c->pidfd);
+    c->pidfd = -1;
+  }
+}
+
+static void handle_child_event(void *data);
+
+/* Start watching the child's current pid.  Without pidfds a crash is only
+ * noticed when the child is stopped. */
+static void watch(struct supervised_child *c)
+{
+  c->pidfd = open_pidfd(c->pid);
+
+  if (c->pidfd < 0) {
+    g_debug("cannot watch child %s (%d): %s", c->name, (int) c->pid,
+            g_strerror(errno));
+    return;
+  }
+
+  (void) fcntl(c->pidfd, F_SETFD, FD_CLOEXEC);
+  events_add_fd(c->pidfd, handle_child_event, c);
+}
+
+/* Start the child through the zygote if possible. */
+static bool spawn(struct child_process *child, GError **error)
+{
+  if (zygote_spawn(child))
+    return true;
+
+  return create_child(child, error);
+}
+
+static void remove_child(struct supervised_child *c)
+{
+  unwatch(c);
+
+  if (c->restart_timer != 0)
+    events_remove_timer(c->restart_timer);
+
+  if (c->cold_timer != 0)
+    events_remove_timer(c->cold_timer);
+
+  g_debug("child %s (%d): uptime %.1fs, %u restarts", c->name, (int) c->pid,
+          (monotonic_ns() - c->started) / 1e9, c->restarts);
+
+  children = g_list_remove(children, c);
+  g_free(c->name);
+  g_free(c);
+}
+
+static void restart_child(void *data)
+{
+  struct supervised_child *c = data;
+  struct child_process child = c->template;
+  GError *err = NULL;
+
+  c->restart_timer = 0;
+
+  if (!spawn(&child, &err)) {
+    g_warning("could not restart %s: %s", c->name, err->message);
+    g_clear_error(&err);
+    return;
+  }
+
+  c->pid = child.pid;
+  c->alive = true;
+  c->child->pid = child.pid;
+  c->started = monotonic_ns();
+  c->restarts++;
+
+  g_debug("restarted %s as %d", c->name, (int) c->pid);
+
+  watch(c);
+}
+
+static void handle_child_event(void *data)
+{
+  struct supervised_child *c = data;
+  uint64_t uptime = monotonic_ns() - c->started;
+  unsigned int delay;
+  int status;
+
+  unwatch(c);
+
+  if (!c->restart) {
+    /* The owner reaps the child, which keeps its pid from being reused. */
+    g_debug("child %s (%d) died after %.1fs", c->name, (int) c->pid,
+            uptime / 1e9);
+    return;
+  }
+
+  if (waitpid(c->pid, &status, WNOHANG) != c->pid)
+    return;
+
+  c->alive = false;
+
+  if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+    g_debug("child %s (%d) finished", c->name, (int) c->pid);
+    return;
+  }
+
+  if (WIFSIGNALED(status) && WTERMSIG(status) == SIGXCPU) {
+    /* A restart would only reset the limit of its resource policy. */
+    g_warning("%s (%d) used up its CPU time limit", c->name, (int) c->pid);
+    return;
+  }
+
+  if (uptime >= (uint64_t) STABLE_UPTIME_MS * 1000000)
+    c->failures = 0;
+
+  if (c->failures >= max_restarts()) {
+    g_warning("%s keeps crashing, giving up", c->name);
+    return;
+  }
+
+  delay = RESTART_DELAY_MS << MIN(c->failures, 16U);
+  delay = MIN(delay, MAX_RESTART_DELAY_MS);
+  c->failures++;
+
+  if (WIFSIGNALED(status))
+    g_warning("%s (%d) was killed by signal %d, restarting in %u ms",
+              c->name, (int) c->pid, WTERMSIG(status), delay);
+  else
+    g_warning("%s (%d) exited with status %d, restarting in %u ms",
+              c->name, (int) c->pid, WEXITSTATUS(status), delay);
+
+  c->restart_timer = events_add_timer(monotonic_ns()
+                                      + (uint64_t) delay * 1000000,
+                                      restart_child, c);
+}
+
+bool supervisor_spawn(const char *name, struct child_process *child,
+                      bool restart, GError **error)
+{
+  struct supervised_child *c;
+  struct child_process template = *child;
+
+  if (!spawn(child, error))
+    return false;
+
+  c = g_malloc0(sizeof *c);
+  c->name = g_strdup(name);
+  c->child = restart ? child : NULL;
+  c->template = template;
+  c->pid = child->pid;
+  c->alive = true;
+  c->stdin_fd = template.stdin_fd == REDIRECT_PIPE ? child->stdin_fd : -1;
+  c->restart = restart;
+  c->started = monotonic_ns();
+
+  /* Restarted children cannot get new pipes to the caller. */
+  if (restart
+      && (template.stdin_fd == REDIRECT_PIPE
+          || template.stdout_fd == REDIRECT_PIPE
+          || template.stderr_fd == REDIRECT_PIPE))
+    c->restart = false;
+
+  children = g_list_append(children, c);
+  watch(c);
+
+  return true;
+}
+
+void supervisor_forget(pid_t pid)
+{
+  struct supervised_child *c = find_child(pid);
+
+  if (c != NULL)
+    remove_child(c);
+}
+
+void supervisor_stop(pid_t pid)
+{
+  struct supervised_child *c = find_child(pid);
+
+  if (c != NULL && (c->suspended || c->frozen)) {
+    /* A stopped child would only act on SIGTERM after the grace period of
+     * ensure_death() when it gets SIGKILL. */
+    (void) kill(pid, SIGTERM);
+    (void) kill(pid, SIGCONT);
+  }
+
+  supervisor_forget(pid);
+  ensure_death(pid);
+}
+
+static void go_cold(void *data)
+{
+  struct supervised_child *c = data;
+
+  c->cold_timer = 0;
+  g_debug("%s (%d) was suspended too long, stopping it", c->name,
+          (int) c->pid);
+  supervisor_stop(c->pid);
+}
+
+void supervisor_suspend(pid_t pid)
+{
+  struct supervised_child *c = find_child(pid);
+  uint64_t warm = warm_time();
+
+  /* A dead child or one waiting to be restarted is not worth keeping. */
+  if (c == NULL || !c->alive || c->restart_timer != 0 || warm == 0
+      || kill(pid, SIGSTOP) < 0) {
+    supervisor_stop(pid);
+    return;
+  }
+
+  c->suspended = true;
+  c->suspended_at = monotonic_ns();
+  c->cold_timer = events_add_timer(monotonic_ns() + warm, go_cold, c);
+}
+
+bool supervisor_resume(pid_t pid)
+{
+  struct supervised_child *c = find_child(pid);
+
+  if (c == NULL || !c->suspended)
+    return false;
+
+  /* The timer may not have fired yet if vlock was not waiting for input. */
+  if (monotonic_ns() - c->suspended_at >= warm_time()) {
+    supervisor_stop(pid);
+    return false;
+  }
+
+  events_remove_timer(c->cold_timer);
+  c->cold_timer = 0;
+  c->suspended = false;
+
+  if (!c->alive || kill(pid, SIGCONT) < 0) {
+    supervisor_stop(pid);
+    return false;
+  }
+
+  return true;
+}
+
+void supervisor_freeze(void)
+{
+  for (GList *item = children; item != NULL; item = g_list_next(item)) {
+    struct supervised_child *c = item->data;
+
+    /* Only the restartable children (screen savers), not scripts, which may
+     * have to answer hooks. */
+    if (!c->restart || !c->alive || c->suspended || c->frozen
+        || c->restart_timer != 0)
+      continue;
+
+    if (kill(c->pid, SIGSTOP) == 0)
+      c->frozen = true;
+  }
+}
+
+void supervisor_thaw(void)
+{
+  for (GList *item = children; item != NULL; item = g_list_next(item)) {
+    struct supervised_child *c = item->data;
+
+    if (!c->frozen)
+      continue;
+
+    c->frozen = false;
+    (void) kill(c->pid, SIGCONT);
+  }
+}
+
+bool supervisor_get_stats(pid_t pid, uint64_t *uptime, unsigned int *restarts)
+{
+  struct supervised_child *c = find_child(pid);
+
+  if (c == NULL)
+    return false;
+
+  if (uptime != NULL)
+    *uptime = monotonic_ns() - c->started;
+
+  if (restarts != NULL)
+    *restarts = c->restarts;
+
+  return true;
+}
+
+/* Wait until all children in the given list are reaped or the deadline (0
+ * meaning none) has passed.  Reaped children are removed from the list. */
+static void wait_all(GList **pending, uint64_t deadline)
+{
+  while (*pending != NULL) {
+    guint n = g_list_length(*pending);
+    struct pollfd *pfds = g_new(struct pollfd, n);
+    bool polling = false;
+    uint64_t now;
+    int timeout = -1;
+    guint i = 0;
+
+    for (GList *item = *pending; item != NULL; item = g_list_next(item), i++) {
+      struct supervised_child *c = item->data;
+
+      if (waitpid(c->pid, NULL, WNOHANG) != 0) {
+        /* Reaped now or by someone else before. */
+        c->alive = false;
+        pfds[i].fd = -1;
+        continue;
+      }
+
+      if (c->pidfd < 0)
+        c->pidfd = open_pidfd(c->pid);
+
+      /* Without a pidfd the child has to be polled for. */
+      if (c->pidfd < 0)
+        polling = true;
+
+      pfds[i].fd = c->pidfd;
+      pfds[i].events = POLLIN;
+    }
+
+    for (GList *item = *pending; item != NULL; ) {
+      struct supervised_child *c = item->data;
+      GList *next = g_list_next(item);
+
+      if (!c->alive)
+        *pending = g_list_delete_link(*pending, item);
+
+      item = next;
+    }
+
+    now = monotonic_ns();
+
+    if (*pending == NULL || (deadline != 0 && now >= deadline)) {
+      g_free(pfds);
+      break;
+    }
+
+    if (deadline != 0)
+      timeout = (int) ((deadline - now + 999999) / 1000000);
+
+    if (polling && (timeout < 0 || timeout > 10))
+      timeout = 10;
+
+    /* The array still has entries for reaped children, which are ignored
+     * because of their negative fd. */
+    (void) poll(pfds, n, timeout);
+    g_free(pfds);
+  }
+}
+
+static void kill_all(GList *pending, int signum)
+{
+  for (GList *item = pending; item != NULL; item = g_list_next(item)) {
+    struct supervised_child *c = item->data;
+    (void) kill(c->pid, signum);
+  }
+}
+
+void supervisor_teardown(void)
+{
+  GList *pending = NULL;
+  GList *piped = NULL;
+  bool signaled = false;
+  int devnull = open("/dev/null", O_RDWR | O_CLOEXEC);
+
+  for (GList *item = children; item != NULL; item = g_list_next(item)) {
+    struct supervised_child *c = item->data;
+
+    /* No more restarts. */
+    unwatch(c);
+
+    if (c->restart_timer != 0) {
+      events_remove_timer(c->restart_timer);
+      c->restart_timer = 0;
+    }
+
+    if (c->cold_timer != 0) {
+      events_remove_timer(c->cold_timer);
+      c->cold_timer = 0;
+    }
+
+    if (!c->alive)
+      continue;
+
+    pending = g_list_append(pending, c);
+
+    /* Children reading commands from a pipe (scripts) see end-of-file and
+     * get to exit on their own.  Replacing the descriptor instead of closing
+     * it keeps it valid for its owner, who still closes it. */
+    if (c->stdin_fd >= 0 && devnull >= 0) {
+      (void) dup2(devnull, c->stdin_fd);
+      piped = g_list_append(piped, c);
+    } else {
+      (void) kill(c->pid, SIGTERM);
+
+      if (c->suspended || c->frozen)
+        (void) kill(c->pid, SIGCONT);
+    }
+  }
+
+  if (devnull >= 0)
+    (void) close(devnull);
+
+  /* All children share the deadlines, so teardown takes at most two grace
+   * periods however many children there are. */
+  wait_all(&pending, monotonic_ns() + TEARDOWN_GRACE_MS * 1000000ULL);
+
+  for (GList *item = piped; item != NULL; item = g_list_next(item)) {
+    struct supervised_child *c = item->data;
+
+    if (c->alive) {
+      (void) kill(c->pid, SIGTERM);
+      signaled = true;
+    }
+  }
+
+  g_list_free(piped);
+
+  /* The others already had their grace period after SIGTERM. */
+  if (signaled)
+    wait_all(&pending, monotonic_ns() + TEARDOWN_GRACE_MS * 1000000ULL);
+
+  if (pending != NULL) {
+    kill_all(pending, SIGKILL);
+    /* Children may be stopped. */
+    kill_all(pending, SIGCONT);
+    wait_all(&pending, 0);
+  }
+
+  while (children != NULL)
+    remove_child(children->data);
+}
@@ -0,0 +1,67 @@
+/* supervisor.h -- header file for the child supervisor of vlock,
+ *                 the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <glib.h>
+
+#include "process.h"
+
+/* Create a child process with create_child() and watch it.  If restart is
+ * true the child is started again with the same parameters when it dies of
+ * a signal or exits with an error, and the pid field of the given struct is
+ * updated.  The struct must then stay valid until supervisor_stop() is
+ * called, e.g. by being static.  Otherwise the child is only watched and its
+ * death reported; it is never reaped by the supervisor. */
+bool supervisor_spawn(const char *name, struct child_process *child,
+                      bool restart, GError **error);
+
+/* Stop watching the child with the given pid and kill it with
+ * ensure_death(). */
+void supervisor_stop(pid_t pid);
+
+/* Stop the child with the given pid with SIGSTOP instead of killing it, so
+ * its state and screen survive until supervisor_resume().  A child that is
+ * not resumed within VLOCK_SAVER_WARM seconds is stopped for good with
+ * supervisor_stop(). */
+void supervisor_suspend(pid_t pid);
+
+/* Continue the child with the given pid with SIGCONT.  Returns false if it
+ * is not suspended any more, e.g. because it was suspended for too long or
+ * died, and has to be started again. */
+bool supervisor_resume(pid_t pid);
+
+/* Stop all running restartable children with SIGSTOP, e.g. while the
+ * screen is blanked.  Unlike supervisor_suspend() there is no time limit. */
+void supervisor_freeze(void);
+
+/* Continue the children stopped by supervisor_freeze(). */
+void supervisor_thaw(void);
+
+/* Stop watching the child with the given pid, leaving it running. */
+void supervisor_forget(pid_t pid);
+
+/* Get the time in nanoseconds the child with the given pid has been running
+ * since it was last (re)started and how often it was restarted.  Returns false
+ * if the child is not supervised. */
+bool supervisor_get_stats(pid_t pid, uint64_t *uptime, unsigned int *restarts);
+
+/* Stop all supervised children at once.  Children with a stdin pipe get
+ * end-of-file first, all others SIGTERM.  After a grace period those with a
+ * pipe get SIGTERM and another grace period, then everything that is left
+ * gets SIGKILL.  All children share the deadlines and are reaped. */
+void supervisor_teardown(void);
@@ -0,0 +1,164 @@
+/* telemetry.c -- screen saver telemetry for vlock,
+ *                the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* Tracks what each screen saver costs: how long it takes to show its first
+ * frame after the screen is handed to it, and how many frames it renders,
+ * drops and spends time on, whether it draws from vlock-main's event loop or
+ * in a child process.  vlock-main claims the slots and stamps the start; the
+ * saver publishes the rest (see modules/frame_clock.c).  vlock-main writes
+ * the counters to the debug log whenever the savers are stopped. */
+
+#if !defined(__FreeBSD__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <glib.h>
+
+#include "util.h"
+#include "telemetry.h"
+
+static struct saver_telemetry *slots = NULL;
+
+void telemetry_init(void)
+{
+  void *page = mmap(NULL, TELEMETRY_SLOTS * sizeof *slots,
+                    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+                    -1, 0);
+
+  if (page == MAP_FAILED) {
+    g_debug("saver telemetry disabled: %s", g_strerror(errno));
+    return;
+  }
+
+  /* Anonymous pages start out zeroed, i.e. all slots are free. */
+  slots = page;
+}
+
+struct saver_telemetry *telemetry_find(const char *name)
+{
+  if (slots == NULL)
+    return NULL;
+
+  for (int i = 0; i < TELEMETRY_SLOTS && slots[i].name[0] != '\0'; i++)
+    if (strcmp(slots[i].name, name) == 0)
+      return &slots[i];
+
+  return NULL;
+}
+
+void telemetry_save_started(const char *name)
+{
+  struct saver_telemetry *slot = telemetry_find(name);
+
+  if (slot == NULL && slots != NULL) {
+    /* Only vlock-main claims slots, so there is no race. */
+    for (int i = 0; i < TELEMETRY_SLOTS; i++)
+      if (slots[i].name[0] == '\0') {
+        slot = &slots[i];
+        (void) g_strlcpy(slot->name, name, sizeof slot->name);
+        break;
+      }
+  }
+
+  if (slot == NULL)
+    return;
+
+  slot->first_frame = 0;
+  slot->save_started = monotonic_ns();
+}
+
+void telemetry_frame_done(struct saver_telemetry *slot)
+{
+  if (slot != NULL && slot->first_frame == 0 && slot->save_started != 0)
+    slot->first_frame = monotonic_ns();
+}
+
+uint64_t telemetry_first_frame_ns(const char *name)
+{
+  struct saver_telemetry *slot = telemetry_find(name);
+
+  if (slot == NULL || slot->first_frame == 0)
+    return 0;
+
+  return slot->first_frame - slot->save_started;
+}
+
+void telemetry_attach(struct saver_telemetry *slot)
+{
+  if (slot == NULL || slot->pid == getpid())
+    return;
+
+  slot->frames = 0;
+  slot->dropped = 0;
+  slot->update_ns = 0;
+  slot->render_ns = 0;
+  slot->flush_ns = 0;
+  slot->bytes = 0;
+  slot->cpu_ns = 0;
+  slot->pid = getpid();
+}
+
+static uint64_t timeval_ns(const struct timeval *tv)
+{
+  return (uint64_t) tv->tv_sec * 1000000000 + (uint64_t) tv->tv_usec * 1000;
+}
+
+void telemetry_sample_process(struct saver_telemetry *slot)
+{
+  struct rusage usage;
+  int fd;
+
+  if (slot == NULL)
+    return;
+
+  if (getrusage(RUSAGE_SELF, &usage) == 0)
+    slot->cpu_ns = timeval_ns(&usage.ru_utime) + timeval_ns(&usage.ru_stime);
+
+  /* Opened every time, a descriptor would outlive a fork(). */
+  fd = open("/proc/self/io", O_RDONLY | O_CLOEXEC);
+
+  if (fd >= 0) {
+    long bytes = io_bytes_written(fd);
+
+    if (bytes >= 0)
+      slot->bytes = bytes;
+
+    (void) close(fd);
+  }
+}
+
+void telemetry_log(const char *name)
+{
+  struct saver_telemetry *slot = telemetry_find(name);
+  uint64_t frames;
+
+  if (slot == NULL || slot->frames == 0)
+    return;
+
+  frames = slot->frames;
+
+  g_debug("%s (pid %d): %" G_GUINT64_FORMAT " frames, %" G_GUINT64_FORMAT
+          " dropped, per frame %.3f ms update, %.3f ms render, %.3f ms flush;"
+          " %" G_GUINT64_FORMAT " bytes written, %.1f ms CPU",
+          name, (int) slot->pid, frames, slot->dropped,
+          slot->update_ns / 1e6 / frames, slot->render_ns / 1e6 / frames,
+          slot->flush_ns / 1e6 / frames, slot->bytes, slot->cpu_ns / 1e6);
+}
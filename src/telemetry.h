@@ -0,0 +1,76 @@
+/* telemetry.h -- header file for the screen saver telemetry of vlock,
+ *                the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/* How many savers can be tracked at the same time. */
+#define TELEMETRY_SLOTS 16
+
+/* What a screen saver tells vlock-main about its frames.  Like the overlay
+ * it lives in a page shared with all children, so a saver rendering in its
+ * own process reports without a channel of its own. */
+struct saver_telemetry
+{
+  char name[32];
+  /* monotonic_ns() when the saver's "vlock_save" hook was called, and when
+   * the first frame after that was done, 0 until then. */
+  volatile uint64_t save_started;
+  volatile uint64_t first_frame;
+
+  /* Published by the process that renders the saver after every frame.  The
+   * counts are totals since that process attached; a restarted saver starts
+   * over.  Readers may see them a frame apart from each other. */
+  volatile pid_t pid;
+  volatile uint64_t frames;
+  volatile uint64_t dropped;
+  /* Time spent advancing the animation, drawing the frame and writing it
+   * to the terminal. */
+  volatile uint64_t update_ns;
+  volatile uint64_t render_ns;
+  volatile uint64_t flush_ns;
+  /* Sampled about once a second, 0 if unknown. */
+  volatile uint64_t bytes;
+  volatile uint64_t cpu_ns;
+};
+
+/* Set up the shared page.  Must be called before any child that should
+ * report is forked, i.e. before zygote_start(). */
+void telemetry_init(void);
+
+/* Return the slot of the saver with the given name, or NULL if there is
+ * none.  Savers look it up once and keep it. */
+struct saver_telemetry *telemetry_find(const char *name);
+
+/* Called by vlock-main right before the "vlock_save" hook of the named
+ * saver.  Claims a slot for it the first time. */
+void telemetry_save_started(const char *name);
+
+/* Called by a saver when a frame is done. */
+void telemetry_frame_done(struct saver_telemetry *slot);
+
+/* Make the calling process the one that renders the saver of the slot.
+ * Clears the counters unless it already was. */
+void telemetry_attach(struct saver_telemetry *slot);
+
+/* Sample the bytes written and the CPU time used by the calling process. */
+void telemetry_sample_process(struct saver_telemetry *slot);
+
+/* Write the counters of the named saver to the debug log. */
+void telemetry_log(const char *name);
+
+/* Return how long the named saver took from "vlock_save" to its first
+ * frame, 0 if it has not shown one yet. */
+uint64_t telemetry_first_frame_ns(const char *name);
@@ -20,6 +20,7 @@
 #include <string.h>
 #include <errno.h>
 #include <time.h>
+#include <unistd.h>
 
 #include <glib.h>
 
@@ -51,6 +52,50 @@ struct timespec *parse_seconds(const char *s)
   }
 }
 
+uint64_t monotonic_ns(void)
+{
+  struct timespec now;
+
+  (void) clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+long io_bytes_written(int fd)
+{
+  char buf[512];
+  ssize_t n = pread(fd, buf, sizeof buf - 1, 0);
+  char *wchar;
+
+  if (n <= 0)
+    return -1;
+
+  buf[n] = '\0';
+  wchar = strstr(buf, "wchar:");
+
+  return wchar != NULL ? strtol(wchar + 6, NULL, 10) : -1;
+}
+
+const char *plugin_getenv(const char *name, const char *key)
+{
+  GString *variable = g_string_new("VLOCK_");
+  const char *value;
+
+  for (const char *p = name; *p != '\0'; p++)
+    g_string_append_c(variable, g_ascii_isalnum(*p) ? g_ascii_toupper(*p) : '_');
+
+  g_string_append_c(variable, '_');
+
+  for (const char *p = key; *p != '\0'; p++)
+    g_string_append_c(variable, g_ascii_isalnum(*p) ? g_ascii_toupper(*p) : '_');
+
+  value = g_getenv(variable->str);
+
+  g_string_free(variable, true);
+
+  return value;
+}
+
 static GList *atexit_functions;
 
 typedef union
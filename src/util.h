@@ -12,6 +12,7 @@
  */
 
 #include <stddef.h>
+#include <stdint.h>
 
 struct timespec;
 
@@ -21,6 +22,18 @@ struct timespec;
  * is returned, too. */
 struct timespec *parse_seconds(const char *s);
 
+/* Return the current value of CLOCK_MONOTONIC in nanoseconds. */
+uint64_t monotonic_ns(void);
+
+/* Return the number of bytes a process has written so far, read from its
+ * /proc/<pid>/io opened as the given descriptor.  Counts every write(), to a
+ * terminal as well as to a file.  Returns -1 if it cannot be read. */
+long io_bytes_written(int fd);
+
+/* Get the plugin setting VLOCK_<NAME>_<KEY> from the environment.  The name
+ * and key are mangled the same way vlock-config maps modules.<name>.<key>. */
+const char *plugin_getenv(const char *name, const char *key);
+
 void vlock_invoke_atexit(void);
 void vlock_atexit(void (*function)(void));
 
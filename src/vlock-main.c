@@ -19,6 +19,7 @@
 #include <pwd.h>
 
 #include <unistd.h>
+#include <termios.h>
 #include <sys/types.h>
 #include <errno.h>
 #include <time.h>
@@ -38,6 +39,12 @@
 #ifdef USE_PLUGINS
 #include "plugins.h"
 #include "plugin.h"
+#include "profile.h"
+#include "supervisor.h"
+#include "zygote.h"
+#include "overlay.h"
+#include "powersave.h"
+#include "telemetry.h"
 #endif
 
 static const char *auth_failure_blurb =
@@ -117,6 +124,8 @@ static void auth_loop(const char *username)
   bool saver_only = env_is_true("VLOCK_SAVER");
   /* Which key(s) dismiss the saver (VLOCK_WAKE_KEY); NULL means any key. */
   const char *wake_charset = wake_key_charset();
+  /* Whether the screen savers are running, possibly behind the prompt. */
+  bool saving = false;
 #else
   wait_timeout = NULL;
 #endif
@@ -124,34 +133,61 @@ static void auth_loop(const char *username)
   for (;;) {
     char c;
 
-    /* Print vlock message if there is one. */
-    if (vlock_message && *vlock_message) {
-      fputs(vlock_message, stderr);
-      fputc('\n', stderr);
-    }
+#ifdef USE_PLUGINS
+    /* With the prompt overlay the savers are still running after a failed
+     * attempt, so go back to waiting for the wake key. */
+    if (!saving) {
+#endif
+      /* Print vlock message if there is one. */
+      if (vlock_message && *vlock_message) {
+        fputs(vlock_message, stderr);
+        fputc('\n', stderr);
+      }
 
-    /* Wait for enter or escape to be pressed.  In saver mode start the screen
-     * saver immediately by acting as if ESC had been pressed. */
+      /* Wait for enter or escape to be pressed.  In saver mode start the
+       * screen saver immediately by acting as if ESC had been pressed. */
 #ifdef USE_PLUGINS
-    if (saver_only)
-      c = '\033';
-    else
+      if (saver_only)
+        c = '\033';
+      else
 #endif
-      c = wait_for_character("\n\r\033", wait_timeout, NULL);
+        c = wait_for_character("\n\r\033", wait_timeout, NULL);
 
-    /* Escape was pressed or the timeout occurred. */
-    if (c == '\033' || c == 0) {
+      /* Escape was pressed or the timeout occurred. */
+      if (c == '\033' || c == 0) {
 #ifdef USE_PLUGINS
-      plugin_hook("vlock_save");
+        /* Before the hooks, whose watchdog deadlines would otherwise
+         * include the wait for the savers to be prepared. */
+        (void) zygote_wait_ready();
+        plugin_hook("vlock_save");
+        powersave_start();
+        saving = true;
+#else
+        continue;
+#endif
+      }
+#ifdef USE_PLUGINS
+    }
+
+    if (saving) {
       /* Wait for the configured wake key (any key by default). */
       (void) wait_for_character(wake_charset, NULL, NULL);
-      plugin_hook("vlock_save_abort");
 
-      /* Any key dismisses the saver and brings up the password prompt. */
-#else
-      continue;
-#endif
+      /* Unblank the screen and restore the savers' frame rate. */
+      powersave_stop();
+
+      /* Drop the frames still queued for a slow terminal, so the prompt
+       * does not have to wait for them. */
+      (void) tcflush(STDOUT_FILENO, TCOFLUSH);
+
+      /* Any key brings up the password prompt, over the savers if the
+       * overlay is enabled and on a cleared screen otherwise. */
+      if (!overlay_begin()) {
+        plugin_hook("vlock_save_abort");
+        saving = false;
+      }
     }
+#endif
 
     for (size_t i = 0; auth_names[i] != NULL; i++) {
       if (auth(auth_names[i], prompt_timeout, &err))
@@ -178,10 +214,25 @@ static void auth_loop(const char *username)
       sleep(1);
     }
 
+#ifdef USE_PLUGINS
+    /* Let the savers have the whole screen again. */
+    if (saving) {
+      overlay_end();
+      powersave_start();
+    }
+#endif
+
     auth_tries++;
   }
 
 auth_success:
+#ifdef USE_PLUGINS
+  if (saving) {
+    overlay_end();
+    plugin_hook("vlock_save_abort");
+  }
+#endif
+
   /* Free timeouts memory. */
   free(wait_timeout);
   free(prompt_timeout);
@@ -254,6 +305,11 @@ int main(int argc, char *const argv[])
   }
 
   vlock_atexit(unload_plugins);
+  /* Stop all children together before the plugins are unloaded one by
+   * one. */
+  vlock_atexit(supervisor_teardown);
+  /* Runs after the vlock_end hooks, so their timings are included. */
+  vlock_atexit(profile_report);
 
   if (!resolve_dependencies(&tmp_error)) {
     g_assert(tmp_error != NULL);
@@ -264,7 +320,25 @@ int main(int argc, char *const argv[])
     exit(EXIT_FAILURE);
   }
 
+  /* The savers share the overlay and power saving state, so they have to
+   * exist before the zygote. */
+  overlay_init();
+  vlock_atexit(overlay_end);
+  powersave_init();
+  vlock_atexit(powersave_stop);
+  telemetry_init();
+
   plugin_hook("vlock_start");
+
+  /* Fork the zygote that starts the screen savers only now, since a
+   * vlock_start hook may have moved vlock to another console (see
+   * modules/new.c) that the savers have to be prepared for.  It prepares
+   * them while the screen is locked. */
+  if (zygote_start(plugins_prepare))
+    vlock_atexit(zygote_stop);
+  else
+    plugins_prepare();
+
   vlock_atexit(call_end_hook);
 #else /* !USE_PLUGINS */
   /* Emulate pseudo plugin "all". */
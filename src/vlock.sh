@@ -344,7 +344,8 @@ main() {
 
   # Export variables for vlock-main.
   export_if_set VLOCK_TIMEOUT VLOCK_PROMPT_TIMEOUT VLOCK_SAVER VLOCK_TRAIN_RANDOM
-  export_if_set VLOCK_CMATRIX_COLOR VLOCK_CMATRIX_BOLD VLOCK_INFO_BOX
+  export_if_set VLOCK_CMATRIX_COLOR VLOCK_CMATRIX_BOLD VLOCK_CMATRIX_ASYNC
+  export_if_set VLOCK_INFO_BOX
   export_if_set VLOCK_MESSAGE VLOCK_ALL_MESSAGE VLOCK_CURRENT_MESSAGE
 
   if [ "${VLOCK_ENABLE_PLUGINS}" = "yes" ] ; then
@@ -0,0 +1,194 @@
+/* watchdog.c -- hook watchdog for vlock, the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* Module hooks run inside vlock-main, so a module stuck in a blocking call
+ * would hold up locking or unlocking forever.  While a hook runs a POSIX
+ * timer is armed.  When it expires a message naming the plugin is printed
+ * and the signal keeps being delivered periodically.  The handler is
+ * installed without SA_RESTART, so blocking system calls in the hook fail
+ * with EINTR and the hook gets a chance to return.  A hook that overran is
+ * treated as failed by the caller.
+ *
+ * The timer uses a realtime signal so it does not interfere with alarms a
+ * module may set up itself. */
+
+#if !defined(__FreeBSD__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+
+#include <glib.h>
+
+#include "plugin.h"
+#include "watchdog.h"
+
+#define WATCHDOG_SIGNAL (SIGRTMIN + 1)
+
+/* Once expired the signal is repeated at this interval. */
+#define REPEAT_INTERVAL_MS 100
+
+/* Deadlines in milliseconds, indexed like the hooks array.  0 disables the
+ * watchdog for a hook.  Filled in on first use. */
+static long deadlines[nr_hooks];
+static bool deadlines_initialized = false;
+
+static timer_t timer;
+static bool timer_created = false;
+static bool armed = false;
+
+static volatile sig_atomic_t expired = 0;
+
+/* The message is formatted when arming because the signal handler can only
+ * write(). */
+static char message[256];
+static size_t message_length;
+
+/* Default deadlines for vlock_start, vlock_end, vlock_save and
+ * vlock_save_abort. */
+static const long default_deadlines[nr_hooks] = { 10000, 10000, 5000, 5000 };
+
+/* Read the deadline of each hook from VLOCK_WATCHDOG_<HOOK>, e.g.
+ * VLOCK_WATCHDOG_SAVE_ABORT for vlock_save_abort.  VLOCK_WATCHDOG overrides
+ * the defaults for all hooks. */
+static void init_deadlines(void)
+{
+  const char *all = g_getenv("VLOCK_WATCHDOG");
+
+  for (size_t i = 0; i < nr_hooks; i++) {
+    /* Skip the "vlock_" prefix. */
+    char *suffix = g_ascii_strup(hooks[i].name + strlen("vlock_"), -1);
+    char *name = g_strconcat("VLOCK_WATCHDOG_", suffix, NULL);
+    const char *value = g_getenv(name);
+    char *end;
+    long ms;
+
+    deadlines[i] = default_deadlines[i];
+
+    if (value == NULL)
+      value = all;
+
+    if (value != NULL) {
+      ms = strtol(value, &end, 10);
+
+      if (*value != '\0' && *end == '\0' && ms >= 0)
+        deadlines[i] = ms;
+      else
+        g_warning("ignoring invalid value of %s: %s", name, value);
+    }
+
+    g_free(name);
+    g_free(suffix);
+  }
+
+  deadlines_initialized = true;
+}
+
+static void handle_expiry(int signum)
+{
+  int errsv = errno;
+
+  (void) signum;
+
+  if (!expired) {
+    expired = 1;
+    (void) write(STDERR_FILENO, message, message_length);
+  }
+
+  errno = errsv;
+}
+
+static struct timespec ms_to_timespec(long ms)
+{
+  struct timespec ts = {
+    .tv_sec = ms / 1000,
+    .tv_nsec = (ms % 1000) * 1000000,
+  };
+
+  return ts;
+}
+
+void watchdog_arm(const char *plugin_name, size_t hook_index)
+{
+  struct itimerspec spec;
+  int length;
+
+  if (armed)
+    return;
+
+  if (!deadlines_initialized)
+    init_deadlines();
+
+  if (deadlines[hook_index] == 0)
+    return;
+
+  if (!timer_created) {
+    struct sigaction act;
+    struct sigevent sev;
+
+    /* No SA_RESTART, blocking calls in the hook should be interrupted.  The
+     * handler stays installed so that a late signal is harmless. */
+    act.sa_handler = handle_expiry;
+    act.sa_flags = 0;
+    sigemptyset(&act.sa_mask);
+    (void) sigaction(WATCHDOG_SIGNAL, &act, NULL);
+
+    memset(&sev, 0, sizeof sev);
+    sev.sigev_notify = SIGEV_SIGNAL;
+    sev.sigev_signo = WATCHDOG_SIGNAL;
+
+    if (timer_create(CLOCK_MONOTONIC, &sev, &timer) < 0) {
+      g_warning("could not create watchdog timer: %s", g_strerror(errno));
+      return;
+    }
+
+    timer_created = true;
+  }
+
+  length = snprintf(message, sizeof message,
+                    "vlock: plugin '%s': %s hook did not finish within %ld ms\n",
+                    plugin_name, hooks[hook_index].name, deadlines[hook_index]);
+  message_length = length < 0 ? 0 : MIN((size_t) length, sizeof message - 1);
+
+  expired = 0;
+
+  spec.it_value = ms_to_timespec(deadlines[hook_index]);
+  spec.it_interval = ms_to_timespec(REPEAT_INTERVAL_MS);
+
+  if (timer_settime(timer, 0, &spec, NULL) < 0) {
+    g_warning("could not arm watchdog timer: %s", g_strerror(errno));
+    return;
+  }
+
+  armed = true;
+}
+
+bool watchdog_disarm(void)
+{
+  struct itimerspec spec;
+
+  if (!armed)
+    return false;
+
+  memset(&spec, 0, sizeof spec);
+  (void) timer_settime(timer, 0, &spec, NULL);
+
+  armed = false;
+
+  return expired != 0;
+}
@@ -0,0 +1,25 @@
+/* watchdog.h -- header file for the hook watchdog of vlock,
+ *               the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Start the deadline for the hook with the given index (into the global hooks
+ * array) of the given plugin.  Does nothing if the watchdog is disabled for
+ * this hook. */
+void watchdog_arm(const char *plugin_name, size_t hook_index);
+
+/* Stop the deadline.  Returns true if the hook ran past it. */
+bool watchdog_disarm(void);
@@ -0,0 +1,463 @@
+/* zygote.c -- child process zygote for vlock,
+ *             the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+/* Screen savers used to be forked from vlock-main in the vlock_save hook,
+ * after the screen was initialized and authentication ran.  Instead a small
+ * process, the zygote, is forked when locking starts.  It drops privileges,
+ * closes everything it does not need and then waits for requests on a
+ * socket.  Each request names a function of a loaded module which the zygote
+ * runs in a new process.  The new process is created with CLONE_PARENT so that
+ * vlock-main can wait for it like for any other child.  Its stdio is passed
+ * along with the request, so it is the one vlock-main has at that time. */
+
+#if !defined(__FreeBSD__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <sys/socket.h>
+
+#include <glib.h>
+
+#include "util.h"
+#include "zygote.h"
+
+/* Stack of the clone()d child.  It is the child's own copy, as the memory is
+ * not shared. */
+#define CHILD_STACK_SIZE (1024 * 1024)
+
+/* How long to wait for the zygote to answer. */
+#define REPLY_TIMEOUT_MS 1000
+
+/* How long to wait for the zygote to finish preparing the savers.  Waited
+ * for outside the hooks (see zygote_wait_ready()), so it may be as long as
+ * their watchdog deadlines. */
+#define PREPARE_TIMEOUT_MS 5000
+
+struct zygote_request
+{
+  int (*function)(void *argument);
+  void *argument;
+  /* NO_REDIRECT or REDIRECT_DEV_NULL for stdin, stdout and stderr. */
+  int stdio[3];
+  bool have_policy;
+  struct resource_policy policy;
+};
+
+struct zygote_reply
+{
+  pid_t pid;
+  int error;
+};
+
+/* Room for the stdio descriptors sent with a request. */
+union zygote_control
+{
+  char buffer[CMSG_SPACE(3 * sizeof(int))];
+  struct cmsghdr align;
+};
+
+static pid_t zygote_pid = -1;
+static int control_fd = -1;
+
+/* Whether the zygote said it has finished preparing. */
+static bool zygote_ready = false;
+
+/* The request the clone()d child runs, and the descriptors that came with it
+ * for its stdin, stdout and stderr, -1 if not redirected to vlock-main's. */
+static struct zygote_request current_request;
+static int current_stdio[3] = { -1, -1, -1 };
+
+static int run_child(void *argument)
+{
+  int devnull = -1;
+
+  (void) argument;
+
+  for (int fd = 0; fd < 3; fd++)
+    if (current_stdio[fd] >= 0)
+      (void) dup2(current_stdio[fd], fd);
+
+  /* The child does not talk to vlock-main. */
+  close_fds(-1);
+
+  for (int fd = 0; fd < 3; fd++) {
+    if (current_request.stdio[fd] != REDIRECT_DEV_NULL)
+      continue;
+
+    if (devnull < 0)
+      devnull = open("/dev/null", O_RDWR);
+
+    if (devnull >= 0 && devnull != fd)
+      (void) dup2(devnull, fd);
+  }
+
+  if (devnull > STDERR_FILENO)
+    (void) close(devnull);
+
+  if (current_request.have_policy)
+    apply_resource_policy(&current_request.policy);
+
+  _exit(current_request.function(current_request.argument));
+}
+
+/* Receive a request into current_request and the stdio descriptors sent
+ * with it into current_stdio.  Returns 1 on success, 0 if the descriptors do
+ * not match the request and -1 if nothing could be received. */
+static int receive_request(int fd)
+{
+  union zygote_control control;
+  struct iovec iov = {
+    .iov_base = &current_request,
+    .iov_len = sizeof current_request,
+  };
+  struct msghdr msg = {
+    .msg_iov = &iov,
+    .msg_iovlen = 1,
+    .msg_control = control.buffer,
+    .msg_controllen = sizeof control.buffer,
+  };
+  /* The buffer is padded, so it may hold more than three. */
+  int received[sizeof control.buffer / sizeof(int)];
+  size_t count = 0;
+  size_t used = 0;
+  bool match;
+  ssize_t length = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+
+  if (length < 0)
+    return -1;
+
+  for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+       cmsg = CMSG_NXTHDR(&msg, cmsg))
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS
+        && count == 0) {
+      count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      memcpy(received, CMSG_DATA(cmsg), count * sizeof(int));
+    }
+
+  match = length == sizeof current_request
+    && (msg.msg_flags & MSG_CTRUNC) == 0;
+
+  /* One descriptor for each stream that is not redirected, in order. */
+  for (int i = 0; i < 3; i++) {
+    current_stdio[i] = -1;
+
+    if (match && current_request.stdio[i] == NO_REDIRECT) {
+      if (used < count)
+        current_stdio[i] = received[used++];
+      else
+        match = false;
+    }
+  }
+
+  if (match && used == count)
+    return 1;
+
+  for (size_t i = 0; i < count; i++)
+    (void) close(received[i]);
+
+  current_stdio[0] = current_stdio[1] = current_stdio[2] = -1;
+
+  if (length != sizeof current_request) {
+    /* vlock-main closed the socket. */
+    errno = 0;
+    return -1;
+  }
+
+  return 0;
+}
+
+/* Let go of the terminal once prepared, so only the children have it open,
+ * and only the one they were sent. */
+static void release_stdio(void)
+{
+  int devnull = open("/dev/null", O_RDWR);
+
+  if (devnull < 0)
+    return;
+
+  for (int fd = 0; fd < 3; fd++)
+    if (devnull != fd)
+      (void) dup2(devnull, fd);
+
+  if (devnull > STDERR_FILENO)
+    (void) close(devnull);
+}
+
+static void zygote_main(int fd, void (*prepare)(void))
+{
+  char *stack = malloc(CHILD_STACK_SIZE);
+  /* A reply without a child tells vlock-main the zygote is ready. */
+  struct zygote_reply ready = { .pid = 0, .error = 0 };
+
+  /* Precompute what the children will need while vlock-main waits for the
+   * screen saver timeout, so they only have to copy it. */
+  if (prepare != NULL)
+    prepare();
+
+  release_stdio();
+
+  if (send(fd, &ready, sizeof ready, MSG_NOSIGNAL) != sizeof ready)
+    _exit(0);
+
+  for (;;) {
+    struct zygote_reply reply = { .pid = -1, .error = 0 };
+    int received = receive_request(fd);
+
+    if (received < 0 && errno == EINTR)
+      continue;
+
+    /* vlock-main closed the socket or something is badly wrong. */
+    if (received < 0)
+      break;
+
+    if (received == 0) {
+      reply.error = EINVAL;
+    } else if (stack == NULL) {
+      reply.error = ENOMEM;
+    } else {
+      /* The stack grows down on all architectures vlock runs on. */
+      reply.pid = clone(run_child, stack + CHILD_STACK_SIZE,
+                        CLONE_PARENT | SIGCHLD, NULL);
+
+      if (reply.pid < 0)
+        reply.error = errno;
+    }
+
+    for (int i = 0; i < 3; i++)
+      if (current_stdio[i] >= 0) {
+        (void) close(current_stdio[i]);
+        current_stdio[i] = -1;
+      }
+
+    if (send(fd, &reply, sizeof reply, MSG_NOSIGNAL) != sizeof reply)
+      break;
+  }
+
+  _exit(0);
+}
+
+bool zygote_start(void (*prepare)(void))
+{
+  int sv[2];
+
+  if (zygote_pid > 0)
+    return true;
+
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+    g_debug("could not create zygote socket: %s", g_strerror(errno));
+    return false;
+  }
+
+  /* Otherwise buffered output would be written again by every child. */
+  (void) fflush(NULL);
+
+  zygote_pid = fork();
+
+  if (zygote_pid == 0) {
+    close_fds(sv[1]);
+    reset_signal_handlers();
+
+    /* Drop privileges permanently, like create_child() does. */
+    if (setgid(getgid()) != 0 || setuid(getuid()) != 0)
+      _exit(1);
+
+    zygote_main(sv[1], prepare);
+  }
+
+  (void) close(sv[1]);
+
+  if (zygote_pid < 0) {
+    g_debug("could not fork zygote: %s", g_strerror(errno));
+    (void) close(sv[0]);
+    return false;
+  }
+
+  control_fd = sv[0];
+  zygote_ready = false;
+
+  return true;
+}
+
+void zygote_stop(void)
+{
+  if (zygote_pid <= 0)
+    return;
+
+  /* The zygote exits when the socket is closed. */
+  (void) close(control_fd);
+  control_fd = -1;
+
+  if (!wait_for_death(zygote_pid, 0, 500000L))
+    ensure_death(zygote_pid);
+
+  zygote_pid = -1;
+}
+
+/* Send the request along with vlock-main's descriptors for the streams that
+ * are not redirected. */
+static bool send_request(const struct zygote_request *request)
+{
+  union zygote_control control;
+  struct iovec iov = {
+    .iov_base = (void *) request,
+    .iov_len = sizeof *request,
+  };
+  struct msghdr msg = {
+    .msg_iov = &iov,
+    .msg_iovlen = 1,
+  };
+  int fds[3];
+  size_t count = 0;
+
+  for (int fd = 0; fd < 3; fd++)
+    if (request->stdio[fd] == NO_REDIRECT)
+      fds[count++] = fd;
+
+  if (count > 0) {
+    struct cmsghdr *cmsg;
+
+    memset(&control, 0, sizeof control);
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = CMSG_SPACE(count * sizeof(int));
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(count * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, count * sizeof(int));
+  }
+
+  for (;;) {
+    ssize_t length = sendmsg(control_fd, &msg, MSG_NOSIGNAL);
+
+    if (length < 0 && errno == EINTR)
+      continue;
+
+    return length == sizeof *request;
+  }
+}
+
+/* Wait up to the given time for a reply of the zygote.  Signals, e.g. of the
+ * hook watchdog or a console switch, only make it wait for the rest of the
+ * time.  Returns false if no complete reply came in time. */
+static bool receive_reply(struct zygote_reply *reply, int timeout_ms)
+{
+  struct pollfd pfd = { .fd = control_fd, .events = POLLIN };
+  uint64_t deadline = monotonic_ns() + (uint64_t) timeout_ms * 1000000ULL;
+
+  for (;;) {
+    uint64_t now = monotonic_ns();
+    ssize_t length;
+    int ready;
+
+    if (now >= deadline)
+      return false;
+
+    /* Round up so a sub-millisecond remainder does not spin. */
+    ready = poll(&pfd, 1, (int) ((deadline - now + 999999) / 1000000));
+
+    if (ready < 0 && errno == EINTR)
+      continue;
+
+    if (ready != 1)
+      return false;
+
+    length = recv(control_fd, reply, sizeof *reply, 0);
+
+    if (length < 0 && errno == EINTR)
+      continue;
+
+    return length == sizeof *reply;
+  }
+}
+
+bool zygote_wait_ready(void)
+{
+  struct zygote_reply reply;
+
+  if (zygote_pid <= 0)
+    return false;
+
+  if (zygote_ready)
+    return true;
+
+  if (receive_reply(&reply, PREPARE_TIMEOUT_MS) && reply.pid == 0) {
+    zygote_ready = true;
+    return true;
+  }
+
+  g_warning("zygote does not respond, creating children directly");
+  zygote_stop();
+
+  return false;
+}
+
+bool zygote_spawn(struct child_process *child)
+{
+  struct zygote_request request;
+  struct zygote_reply reply;
+  const int stdio[3] = { child->stdin_fd, child->stdout_fd, child->stderr_fd };
+
+  if (zygote_pid <= 0 || !child->zygote_safe || child->function == NULL)
+    return false;
+
+  memset(&request, 0, sizeof request);
+
+  for (int fd = 0; fd < 3; fd++) {
+    if (stdio[fd] != NO_REDIRECT && stdio[fd] != REDIRECT_DEV_NULL)
+      return false;
+
+    request.stdio[fd] = stdio[fd];
+  }
+
+  request.function = child->function;
+  request.argument = child->argument;
+
+  /* The policy is sent along since the zygote's copy of the memory it is in
+   * may be outdated. */
+  if (child->policy != NULL) {
+    request.have_policy = true;
+    request.policy = *child->policy;
+  }
+
+  /* The first child may have to wait until the zygote has prepared it,
+   * unless vlock-main waited already. */
+  if (!zygote_wait_ready())
+    return false;
+
+  if (!send_request(&request) || !receive_reply(&reply, REPLY_TIMEOUT_MS))
+    goto broken;
+
+  if (reply.pid < 0) {
+    g_debug("zygote could not start child: %s", g_strerror(reply.error));
+    return false;
+  }
+
+  child->pid = reply.pid;
+
+  return true;
+
+broken:
+  g_warning("zygote does not respond, creating children directly");
+  zygote_stop();
+  return false;
+}
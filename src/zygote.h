@@ -0,0 +1,42 @@
+/* zygote.h -- header file for the child process zygote of vlock,
+ *             the VT locking program for linux
+ *
+ * This program is copyright (C) 2007 Frank Benkstein, and is free
+ * software which is freely distributable under the terms of the
+ * GNU General Public License version 2, included as the file COPYING in this
+ * distribution.  It is NOT public domain software, and any
+ * redistribution not permitted by the GNU General Public License is
+ * expressly forbidden without prior written permission from
+ * the author.
+ *
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "process.h"
+
+/* Fork the zygote.  Must be called after all plugins are loaded, because
+ * the zygote can only run functions that exist when it is created, and after
+ * the vlock_start hooks, which may move vlock to another console.  Unless it
+ * is NULL, the zygote calls prepare before it accepts requests; the children
+ * inherit whatever it sets up.  Returns false if the zygote could not be
+ * started, in which case children are created by vlock-main directly. */
+bool zygote_start(void (*prepare)(void));
+
+/* Stop the zygote. */
+void zygote_stop(void);
+
+/* Wait until the zygote has finished preparing, for up to 5 seconds.  Called
+ * before the vlock_save hooks, so the wait does not count against their
+ * watchdog deadlines.  Returns false if there is no zygote (any more). */
+bool zygote_wait_ready(void);
+
+/* Let the zygote start the given child.  The child process becomes a child of
+ * vlock-main.  Only works for children with the zygote_safe flag whose stdio
+ * is not redirected to a pipe or another descriptor.  Streams that are not
+ * redirected get vlock-main's current descriptors.  Returns false if the
+ * zygote cannot start the child, in which case it should be created with
+ * create_child(). */
+bool zygote_spawn(struct child_process *child);
@@ -0,0 +1,74 @@
+#include <stdlib.h>
+
+#include <CUnit/CUnit.h>
+
+#include "events.h"
+
+#include "test_events.h"
+
+static int calls[3];
+static unsigned int timers[3];
+
+static void count_call(void *data)
+{
+  calls[*(int *) data]++;
+}
+
+/* Removes the timer after its own. */
+static void remove_next(void *data)
+{
+  int i = *(int *) data;
+
+  calls[i]++;
+  events_remove_timer(timers[i + 1]);
+}
+
+void test_events_timer_order(void)
+{
+  static int index[3] = { 0, 1, 2 };
+  fd_set readfds;
+
+  FD_ZERO(&readfds);
+  calls[0] = calls[1] = calls[2] = 0;
+
+  timers[0] = events_add_timer(2, count_call, &index[0]);
+  timers[1] = events_add_timer(1, count_call, &index[1]);
+  timers[2] = events_add_timer(UINT64_MAX, count_call, &index[2]);
+
+  events_dispatch(&readfds);
+  CU_ASSERT(calls[0] == 1 && calls[1] == 1 && calls[2] == 0);
+
+  /* Fired timers are gone. */
+  events_dispatch(&readfds);
+  CU_ASSERT(calls[0] == 1 && calls[1] == 1);
+
+  events_remove_timer(timers[2]);
+  events_remove_timer(timers[0]);
+}
+
+/* A timer that is due with another one can still be removed by the other
+ * one's callback, e.g. the ticks of a saver by the timer that blanks the
+ * screen. */
+void test_events_remove_due_timer(void)
+{
+  static int index[3] = { 0, 1, 2 };
+  fd_set readfds;
+
+  FD_ZERO(&readfds);
+  calls[0] = calls[1] = calls[2] = 0;
+
+  timers[0] = events_add_timer(1, remove_next, &index[0]);
+  timers[1] = events_add_timer(1, count_call, &index[1]);
+  timers[2] = events_add_timer(1, count_call, &index[2]);
+
+  events_dispatch(&readfds);
+  CU_ASSERT(calls[0] == 1);
+  CU_ASSERT(calls[1] == 0);
+  CU_ASSERT(calls[2] == 1);
+}
+
+CU_TestInfo events_tests[] = {
+  { "test_events_timer_order", test_events_timer_order },
+  { "test_events_remove_due_timer", test_events_remove_due_timer },
+  CU_TEST_INFO_NULL,
+};
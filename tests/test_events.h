@@ -0,0 +1 @@
+extern CU_TestInfo events_tests[];
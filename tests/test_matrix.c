@@ -0,0 +1,174 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <CUnit/CUnit.h>
+
+#include "matrix.h"
+
+#include "test_matrix.h"
+
+void test_matrix_init(void)
+{
+  struct matrix m = { 0 };
+  struct prng rng;
+
+  prng_seed(&rng, 1);
+  CU_ASSERT_FATAL(matrix_init(&m, 24, 81, false, &rng));
+
+  CU_ASSERT(m.streams == 41);
+  CU_ASSERT(m.rows == 25);
+
+  for (int s = 0; s < m.streams; s++) {
+    CU_ASSERT(m.val[matrix_cell(&m, s, 0)] == MATRIX_BLANK);
+    CU_ASSERT(m.val[matrix_cell(&m, s, 1)] == MATRIX_SPACE);
+    CU_ASSERT(m.spaces[s] >= 1 && m.spaces[s] <= 24);
+    CU_ASSERT(m.length[s] >= 3 && m.length[s] < 24);
+    CU_ASSERT(m.updates[s] >= 1 && m.updates[s] <= 3);
+    CU_ASSERT(m.colors[s] >= 0 && m.colors[s] < MATRIX_COLORS);
+  }
+
+  matrix_free(&m);
+}
+
+/* Everything the renderer has to redraw is in the change lists. */
+void test_matrix_changes(void)
+{
+  struct matrix m = { 0 };
+  struct prng rng;
+  int16_t *val;
+  uint8_t *bold;
+  int32_t *colors;
+  bool *listed;
+  int cells;
+
+  prng_seed(&rng, 2);
+  CU_ASSERT_FATAL(matrix_init(&m, 30, 80, false, &rng));
+
+  cells = m.streams * m.rows;
+  val = malloc(cells * sizeof *val);
+  bold = malloc(cells * sizeof *bold);
+  colors = malloc(m.streams * sizeof *colors);
+  listed = malloc(cells * sizeof *listed);
+  CU_ASSERT_FATAL(val != NULL && bold != NULL && colors != NULL
+                  && listed != NULL);
+
+  for (int frame = 0; frame < 1000; frame++) {
+    memcpy(val, m.val, cells * sizeof *val);
+    memcpy(bold, m.bold, cells * sizeof *bold);
+    memcpy(colors, m.colors, m.streams * sizeof *colors);
+    memset(listed, 0, cells * sizeof *listed);
+
+    m.asynch = frame >= 500;
+    matrix_step(&m, frame % 4 + 1);
+
+    CU_ASSERT(!m.all_changed);
+
+    for (int i = 0; i < m.nchanged; i++) {
+      CU_ASSERT(m.changed[i] >= 0 && m.changed[i] < cells);
+
+      if (m.changed[i] >= 0 && m.changed[i] < cells)
+        listed[m.changed[i]] = true;
+    }
+
+    for (int i = 0; i < cells; i++)
+      if (val[i] != m.val[i] || bold[i] != m.bold[i])
+        CU_ASSERT(listed[i]);
+
+    for (int s = 0; s < m.streams; s++) {
+      bool recolored = false;
+
+      for (int i = 0; i < m.nrecolored; i++)
+        recolored = recolored || m.recolored[i] == s;
+
+      if (colors[s] != m.colors[s])
+        CU_ASSERT(recolored);
+    }
+  }
+
+  /* The streams only ever hold glyphs from the range. */
+  for (int i = 0; i < cells; i++)
+    CU_ASSERT(m.val[i] == MATRIX_BLANK || m.val[i] == MATRIX_SPACE
+              || (m.val[i] >= m.randmin && m.val[i] < m.randmin + m.randnum));
+
+  free(val);
+  free(bold);
+  free(colors);
+  free(listed);
+  matrix_free(&m);
+}
+
+/* Old-style scrolling moves every cell, so it does not list them. */
+void test_matrix_oldstyle(void)
+{
+  struct matrix m = { 0 };
+  struct prng rng;
+
+  prng_seed(&rng, 3);
+  CU_ASSERT_FATAL(matrix_init(&m, 20, 40, false, &rng));
+
+  m.oldstyle = true;
+
+  for (int frame = 0; frame < 100; frame++) {
+    matrix_step(&m, frame % 4 + 1);
+    CU_ASSERT(m.all_changed);
+  }
+
+  matrix_free(&m);
+}
+
+/* With asynch only the streams faster than count move, and the wheel lists
+ * each of them once per count, in order. */
+void test_matrix_asynch(void)
+{
+  struct matrix m = { 0 };
+  struct prng rng;
+  int16_t *val;
+  int cells;
+
+  prng_seed(&rng, 4);
+  CU_ASSERT_FATAL(matrix_init(&m, 20, 120, false, &rng));
+
+  cells = m.streams * m.rows;
+  val = malloc(cells * sizeof *val);
+  CU_ASSERT_FATAL(val != NULL);
+
+  m.asynch = true;
+
+  for (int count = 1; count <= MATRIX_TICKS; count++) {
+    int n = m.slots[count - 1];
+
+    for (int s = 0; s < m.streams; s++)
+      if (count > m.updates[s]) {
+        CU_ASSERT(n < m.slots[count] && m.wheel[n] == s);
+        n++;
+      }
+
+    CU_ASSERT(n == m.slots[count]);
+  }
+
+  CU_ASSERT(m.slots[1] == m.slots[0]);
+
+  for (int frame = 0; frame < 400; frame++) {
+    int count = frame % MATRIX_TICKS + 1;
+
+    memcpy(val, m.val, cells * sizeof *val);
+    matrix_step(&m, count);
+
+    for (int s = 0; s < m.streams; s++)
+      if (count <= m.updates[s])
+        CU_ASSERT(memcmp(val + matrix_cell(&m, s, 0),
+                         m.val + matrix_cell(&m, s, 0),
+                         m.rows * sizeof *val) == 0);
+  }
+
+  free(val);
+  matrix_free(&m);
+}
+
+CU_TestInfo matrix_tests[] = {
+  { "test_matrix_init", test_matrix_init },
+  { "test_matrix_changes", test_matrix_changes },
+  { "test_matrix_oldstyle", test_matrix_oldstyle },
+  { "test_matrix_asynch", test_matrix_asynch },
+  CU_TEST_INFO_NULL,
+};
@@ -0,0 +1 @@
+extern CU_TestInfo matrix_tests[];
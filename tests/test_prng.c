@@ -0,0 +1,124 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <CUnit/CUnit.h>
+
+#include "prng.h"
+
+#include "test_prng.h"
+
+/* The reference xoshiro256** for one lane. */
+static uint64_t reference_next(uint64_t s[4])
+{
+  uint64_t result = s[1] * 5;
+  uint64_t t = s[1] << 17;
+
+  result = ((result << 7) | (result >> 57)) * 9;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = (s[3] << 45) | (s[3] >> 19);
+
+  return result;
+}
+
+void test_prng_reference(void)
+{
+  struct prng rng;
+  uint64_t lanes[PRNG_LANES][4];
+
+  prng_seed(&rng, 42);
+
+  for (int lane = 0; lane < PRNG_LANES; lane++)
+    for (int i = 0; i < 4; i++)
+      lanes[lane][i] = rng.s[i][lane];
+
+  /* Each step makes two numbers per lane, lane after lane. */
+  for (int step = 0; step < 100; step++) {
+    for (int lane = 0; lane < PRNG_LANES; lane++) {
+      uint64_t expected = reference_next(lanes[lane]);
+      uint64_t got = prng_next(&rng);
+
+      got |= (uint64_t) prng_next(&rng) << 32;
+      CU_ASSERT(got == expected);
+    }
+  }
+}
+
+void test_prng_seed(void)
+{
+  struct prng a, b;
+  bool same = true;
+
+  prng_seed(&a, 1);
+  prng_seed(&b, 1);
+
+  for (int i = 0; i < 1000; i++)
+    CU_ASSERT(prng_next(&a) == prng_next(&b));
+
+  prng_seed(&b, 2);
+
+  for (int i = 0; i < 10; i++)
+    same = same && prng_next(&a) == prng_next(&b);
+
+  CU_ASSERT(!same);
+
+  /* The same seed gives different users different sequences. */
+  setenv("VLOCK_SEED", "7", 1);
+  prng_init(&a, "cmatrix");
+  prng_init(&b, "cmatrix");
+  CU_ASSERT(prng_next(&a) == prng_next(&b));
+  prng_init(&b, "info_box");
+  CU_ASSERT(prng_next(&a) != prng_next(&b));
+  unsetenv("VLOCK_SEED");
+}
+
+void test_prng_below(void)
+{
+  struct prng rng;
+  int seen[6] = { 0 };
+
+  prng_seed(&rng, 3);
+
+  for (int i = 0; i < 6000; i++) {
+    uint32_t n = prng_below(&rng, 6);
+
+    CU_ASSERT(n < 6);
+
+    if (n < 6)
+      seen[n]++;
+  }
+
+  for (int i = 0; i < 6; i++)
+    CU_ASSERT(seen[i] > 800 && seen[i] < 1200);
+
+  CU_ASSERT(prng_below(&rng, 0) == 0);
+  CU_ASSERT(prng_below(&rng, 1) == 0);
+}
+
+void test_prng_fill(void)
+{
+  struct prng a, b;
+  uint32_t batch[PRNG_BATCH * 3 + 5];
+
+  prng_seed(&a, 9);
+  prng_seed(&b, 9);
+
+  /* Filling continues the sequence of prng_next() where the batch is
+   * used up. */
+  prng_fill(&a, batch, sizeof batch / sizeof batch[0]);
+
+  for (size_t i = 0; i < sizeof batch / sizeof batch[0]; i++)
+    CU_ASSERT(batch[i] == prng_next(&b));
+}
+
+CU_TestInfo prng_tests[] = {
+  { "test_prng_reference", test_prng_reference },
+  { "test_prng_seed", test_prng_seed },
+  { "test_prng_below", test_prng_below },
+  { "test_prng_fill", test_prng_fill },
+  CU_TEST_INFO_NULL,
+};
@@ -0,0 +1 @@
+extern CU_TestInfo prng_tests[];
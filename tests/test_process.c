@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <fcntl.h>
@@ -9,6 +11,7 @@
 #include <CUnit/CUnit.h>
 
 #include "process.h"
+#include "util.h"
 
 #include "test_process.h"
 
@@ -26,6 +29,25 @@ void test_wait_for_death(void)
   CU_ASSERT(wait_for_death(pid, 0, 20000));
 }
 
+void test_wait_for_death_prompt(void)
+{
+  pid_t pid = fork();
+  uint64_t start;
+
+  if (pid == 0) {
+    usleep(20000);
+    _exit(0);
+  }
+
+  start = monotonic_ns();
+
+  /* Returns as soon as the child exits, not at the deadline. */
+  CU_ASSERT(wait_for_death(pid, 5, 0));
+  CU_ASSERT(monotonic_ns() - start < 1000000000);
+
+  CU_ASSERT(waitpid(pid, NULL, WNOHANG) < 0);
+}
+
 void test_ensure_death(void)
 {
   pid_t pid = fork();
@@ -83,7 +105,7 @@ void test_create_child_function(void)
   int status;
   char buffer[LINE_MAX];
 
-  CU_ASSERT(create_child(&child));
+  CU_ASSERT(create_child(&child, NULL));
 
   CU_ASSERT(child.pid > 0);
 
@@ -123,7 +145,7 @@ void test_create_child_process(void)
   };
   char buffer[LINE_MAX];
 
-  CU_ASSERT(create_child(&child));
+  CU_ASSERT(create_child(&child, NULL));
 
   CU_ASSERT(write(child.stdin_fd, s1, l1) == l1);
   (void) close(child.stdin_fd);
@@ -136,10 +158,77 @@ void test_create_child_process(void)
   CU_ASSERT(wait_for_death(child.pid, 0, 0));
 }
 
+/* Exit with 0 if all descriptors of the -1 terminated list are closed. */
+int check_fd_closed(void *a)
+{
+  for (int *fd = a; *fd >= 0; fd++)
+    if (fcntl(*fd, F_GETFD) >= 0 || errno != EBADF)
+      return 1;
+
+  return 0;
+}
+
+void test_create_child_closes_fds(void)
+{
+  int fds[2];
+  int closed[3];
+  int status;
+  struct child_process child = {
+    .function = check_fd_closed,
+    .stdin_fd = REDIRECT_DEV_NULL,
+    .stdout_fd = REDIRECT_DEV_NULL,
+    .stderr_fd = REDIRECT_DEV_NULL,
+  };
+
+  CU_ASSERT(pipe(fds) == 0);
+
+  /* Above the other descriptors, so close_range() has to skip the status
+   * pipe. */
+  CU_ASSERT(dup2(fds[1], 200) == 200);
+  closed[0] = fds[1];
+  closed[1] = 200;
+  closed[2] = -1;
+  child.argument = closed;
+
+  CU_ASSERT(create_child(&child, NULL));
+  CU_ASSERT(waitpid(child.pid, &status, 0) == child.pid);
+  CU_ASSERT(WIFEXITED(status));
+  CU_ASSERT(WEXITSTATUS(status) == 0);
+
+  (void) close(fds[0]);
+  (void) close(fds[1]);
+  (void) close(200);
+}
+
+void test_create_child_not_found(void)
+{
+  const char *argv[] = { "does-not-exist", NULL };
+  struct child_process child = {
+    .path = "/nonexistent/does-not-exist",
+    .argv = argv,
+    .stdin_fd = REDIRECT_PIPE,
+    .stdout_fd = REDIRECT_DEV_NULL,
+    .stderr_fd = REDIRECT_DEV_NULL,
+    .function = NULL,
+  };
+  GError *error = NULL;
+
+  CU_ASSERT(!create_child(&child, &error));
+  CU_ASSERT(error != NULL);
+
+  if (error != NULL) {
+    CU_ASSERT(error->code == VLOCK_PROCESS_ERROR_NOT_FOUND);
+    g_error_free(error);
+  }
+}
+
 CU_TestInfo process_tests[] = {
   { "test_wait_for_death", test_wait_for_death },
+  { "test_wait_for_death_prompt", test_wait_for_death_prompt },
   { "test_ensure_death", test_ensure_death },
   { "test_create_child_function", test_create_child_function },
   { "test_create_child_process", test_create_child_process },
+  { "test_create_child_closes_fds", test_create_child_closes_fds },
+  { "test_create_child_not_found", test_create_child_not_found },
   CU_TEST_INFO_NULL,
 };
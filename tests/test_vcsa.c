@@ -0,0 +1,220 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <CUnit/CUnit.h>
+
+#include "vcsa.h"
+
+#include "test_vcsa.h"
+
+#define ROWS 3
+#define COLS 4
+
+/* A regular file standing in for /dev/vcsaN: header and blank cells. */
+static char *make_screen(int rows, int cols)
+{
+  char *path = strdup("/tmp/vlock-test-vcsa.XXXXXX");
+  unsigned char header[4] = { rows, cols, 0, 0 };
+  unsigned char cell[2] = { ' ', 0x07 };
+  int fd = mkstemp(path);
+
+  CU_ASSERT_FATAL(fd >= 0);
+  CU_ASSERT(write(fd, header, sizeof header) == sizeof header);
+
+  for (int i = 0; i < rows * cols; i++)
+    CU_ASSERT(write(fd, cell, sizeof cell) == sizeof cell);
+
+  close(fd);
+
+  return path;
+}
+
+static void read_cell(const char *path, int y, int x, unsigned char cell[2])
+{
+  FILE *f = fopen(path, "rb");
+
+  CU_ASSERT_FATAL(f != NULL);
+  CU_ASSERT(fseek(f, 4 + (y * COLS + x) * 2, SEEK_SET) == 0);
+  CU_ASSERT(fread(cell, 1, 2, f) == 2);
+  fclose(f);
+}
+
+static void write_cell(const char *path, int y, int x, unsigned char glyph)
+{
+  FILE *f = fopen(path, "r+b");
+
+  CU_ASSERT_FATAL(f != NULL);
+  CU_ASSERT(fseek(f, 4 + (y * COLS + x) * 2, SEEK_SET) == 0);
+  CU_ASSERT(fwrite(&glyph, 1, 1, f) == 1);
+  fclose(f);
+}
+
+static void fill(struct vcsa *vcsa, unsigned char glyph)
+{
+  for (int y = 0; y < ROWS; y++)
+    for (int x = 0; x < COLS; x++)
+      vcsa_put(vcsa, y, x, glyph, 0x07);
+}
+
+void test_vcsa_open(void)
+{
+  char *path = make_screen(ROWS, COLS);
+  struct vcsa *vcsa = vcsa_open(path, -1);
+
+  CU_ASSERT_PTR_NOT_NULL_FATAL(vcsa);
+  CU_ASSERT(vcsa_rows(vcsa) == ROWS);
+  CU_ASSERT(vcsa_cols(vcsa) == COLS);
+  CU_ASSERT(!vcsa_sync_size(vcsa));
+
+  vcsa_close(vcsa);
+
+  /* Too short for the header. */
+  CU_ASSERT(truncate(path, 2) == 0);
+  CU_ASSERT_PTR_NULL(vcsa_open(path, -1));
+
+  unlink(path);
+  free(path);
+
+  CU_ASSERT_PTR_NULL(vcsa_open("/nonexistent/vcsa", -1));
+}
+
+void test_vcsa_flush(void)
+{
+  char *path = make_screen(ROWS, COLS);
+  struct vcsa *vcsa = vcsa_open(path, -1);
+  unsigned char cell[2];
+
+  CU_ASSERT_PTR_NOT_NULL_FATAL(vcsa);
+
+  /* The first flush writes everything in one go. */
+  fill(vcsa, '.');
+  vcsa_put(vcsa, 1, 2, 'x', 0x1e);
+  CU_ASSERT(vcsa_flush(vcsa) == 1);
+
+  read_cell(path, 1, 2, cell);
+  CU_ASSERT(cell[0] == 'x' && cell[1] == 0x1e);
+  read_cell(path, 2, 3, cell);
+  CU_ASSERT(cell[0] == '.' && cell[1] == 0x07);
+
+  /* Nothing changed, nothing written. */
+  CU_ASSERT(vcsa_flush(vcsa) == 0);
+
+  /* Only changed cells are written: a cell changed behind the backend's
+   * back is left alone. */
+  write_cell(path, 2, 3, '#');
+  vcsa_put(vcsa, 0, 0, 'a', 0x07);
+  CU_ASSERT(vcsa_flush(vcsa) == 1);
+
+  read_cell(path, 0, 0, cell);
+  CU_ASSERT(cell[0] == 'a');
+  read_cell(path, 2, 3, cell);
+  CU_ASSERT(cell[0] == '#');
+
+  /* Changes far apart take one write each, close ones are merged. */
+  vcsa_put(vcsa, 0, 0, 'b', 0x07);
+  vcsa_put(vcsa, 0, 2, 'b', 0x07);
+  vcsa_put(vcsa, 2, 2, 'b', 0x07);
+  CU_ASSERT(vcsa_flush(vcsa) == 2);
+
+  /* Cells outside the screen are ignored. */
+  vcsa_put(vcsa, ROWS, 0, 'z', 0x07);
+  vcsa_put(vcsa, 0, -1, 'z', 0x07);
+  CU_ASSERT(vcsa_flush(vcsa) == 0);
+
+  /* After invalidating every cell is written again. */
+  vcsa_invalidate(vcsa);
+  CU_ASSERT(vcsa_flush(vcsa) == 1);
+  read_cell(path, 2, 3, cell);
+  CU_ASSERT(cell[0] == '.');
+
+  vcsa_close(vcsa);
+  unlink(path);
+  free(path);
+}
+
+void test_vcsa_resize(void)
+{
+  char *path = make_screen(ROWS, COLS);
+  struct vcsa *vcsa = vcsa_open(path, -1);
+  unsigned char header[2] = { ROWS + 1, COLS + 2 };
+  FILE *f;
+
+  CU_ASSERT_PTR_NOT_NULL_FATAL(vcsa);
+
+  fill(vcsa, '.');
+  CU_ASSERT(vcsa_flush(vcsa) == 1);
+
+  f = fopen(path, "r+b");
+  CU_ASSERT_FATAL(f != NULL);
+  CU_ASSERT(fwrite(header, 1, sizeof header, f) == sizeof header);
+  fclose(f);
+
+  CU_ASSERT(vcsa_sync_size(vcsa));
+  CU_ASSERT(vcsa_rows(vcsa) == ROWS + 1);
+  CU_ASSERT(vcsa_cols(vcsa) == COLS + 2);
+  CU_ASSERT(!vcsa_sync_size(vcsa));
+
+  /* The whole new screen is written. */
+  CU_ASSERT(vcsa_flush(vcsa) == 1);
+
+  vcsa_close(vcsa);
+  unlink(path);
+  free(path);
+}
+
+void test_vcsa_glyph(void)
+{
+  char *path = make_screen(ROWS, COLS);
+  struct vcsa *vcsa = vcsa_open(path, -1);
+
+  CU_ASSERT_PTR_NOT_NULL_FATAL(vcsa);
+
+  /* Without a console font code page 437 is assumed. */
+  CU_ASSERT(vcsa_glyph(vcsa, 'A') == 'A');
+  CU_ASSERT(vcsa_glyph(vcsa, 0x2500) == 0xc4);
+  CU_ASSERT(vcsa_glyph(vcsa, 0x252c) == 0xc2);
+  CU_ASSERT(vcsa_glyph(vcsa, 0x4e00) == '?');
+  CU_ASSERT(vcsa_glyph(vcsa, '\n') == '?');
+
+  vcsa_close(vcsa);
+  unlink(path);
+  free(path);
+}
+
+/* In a 512 glyph font the intensity bit selects the upper half, so only
+ * fonts of 256 glyphs get bright colors. */
+void test_vcsa_font_512(void)
+{
+  static const unsigned int unicode[] = { 'A', '?', 0x2500 };
+  static const unsigned short small[] = { 'A', '?', 0xc4 };
+  static const unsigned short large[] = { 'A', '?', 0x1c4 };
+  char *path = make_screen(ROWS, COLS);
+  struct vcsa *vcsa = vcsa_open(path, -1);
+
+  CU_ASSERT_PTR_NOT_NULL_FATAL(vcsa);
+  CU_ASSERT(vcsa_bright(vcsa));
+
+  CU_ASSERT(vcsa_set_font_map(vcsa, unicode, small, 3));
+  CU_ASSERT(vcsa_bright(vcsa));
+  CU_ASSERT(vcsa_glyph(vcsa, 0x2500) == 0xc4);
+
+  CU_ASSERT(vcsa_set_font_map(vcsa, unicode, large, 3));
+  CU_ASSERT(!vcsa_bright(vcsa));
+  CU_ASSERT(vcsa_glyph(vcsa, 'A') == 'A');
+  CU_ASSERT(vcsa_glyph(vcsa, 0x2500) == '?');
+
+  vcsa_close(vcsa);
+  unlink(path);
+  free(path);
+}
+
+CU_TestInfo vcsa_tests[] = {
+  { "test_vcsa_open", test_vcsa_open },
+  { "test_vcsa_flush", test_vcsa_flush },
+  { "test_vcsa_resize", test_vcsa_resize },
+  { "test_vcsa_glyph", test_vcsa_glyph },
+  { "test_vcsa_font_512", test_vcsa_font_512 },
+  CU_TEST_INFO_NULL,
+};
@@ -0,0 +1 @@
+extern CU_TestInfo vcsa_tests[];
@@ -0,0 +1,140 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include <CUnit/CUnit.h>
+
+#include "zygote.h"
+
+#include "test_zygote.h"
+
+/* Tell the test which file the child's stdout is. */
+static int write_stdout_inode(void *argument)
+{
+  struct stat st;
+
+  (void) argument;
+
+  if (fstat(STDOUT_FILENO, &st) < 0)
+    return 1;
+
+  return write(STDOUT_FILENO, &st.st_ino, sizeof st.st_ino)
+    == sizeof st.st_ino ? 0 : 1;
+}
+
+/* A child started by the zygote writes to vlock-main's stdout of the time
+ * it is started, not of the time the zygote was forked, e.g. after the new
+ * plugin moved vlock to another console. */
+void test_zygote_stdout(void)
+{
+  char path[] = "/tmp/vlock-test-zygote.XXXXXX";
+  struct child_process child = {
+    .function = write_stdout_inode,
+    .stdin_fd = REDIRECT_DEV_NULL,
+    .stdout_fd = NO_REDIRECT,
+    .stderr_fd = REDIRECT_DEV_NULL,
+    .zygote_safe = true,
+  };
+  struct stat st;
+  ino_t ino = 0;
+  int status;
+  int saved;
+  int fd;
+  bool spawned;
+
+  CU_ASSERT_FATAL(zygote_start(NULL));
+
+  fd = mkstemp(path);
+  CU_ASSERT_FATAL(fd >= 0);
+  CU_ASSERT(fstat(fd, &st) == 0);
+
+  saved = dup(STDOUT_FILENO);
+  CU_ASSERT_FATAL(saved >= 0);
+  (void) dup2(fd, STDOUT_FILENO);
+
+  spawned = zygote_spawn(&child);
+
+  (void) dup2(saved, STDOUT_FILENO);
+  (void) close(saved);
+
+  CU_ASSERT_FATAL(spawned);
+  CU_ASSERT(waitpid(child.pid, &status, 0) == child.pid);
+  CU_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+  CU_ASSERT(pread(fd, &ino, sizeof ino, 0) == sizeof ino);
+  CU_ASSERT(ino == st.st_ino);
+
+  /* Streams redirected to /dev/null are not sent along. */
+  child.stdout_fd = REDIRECT_DEV_NULL;
+  CU_ASSERT_FATAL(zygote_spawn(&child));
+  CU_ASSERT(waitpid(child.pid, &status, 0) == child.pid);
+  CU_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+  zygote_stop();
+  (void) close(fd);
+  (void) unlink(path);
+}
+
+static void slow_prepare(void)
+{
+  (void) usleep(200000);
+}
+
+static void ignore_signal(int signum)
+{
+  (void) signum;
+}
+
+static int exit_zero(void *argument)
+{
+  (void) argument;
+  return 0;
+}
+
+/* Signals while vlock-main waits for the zygote, here every millisecond
+ * while it prepares, do not make it give up on the zygote. */
+void test_zygote_signals(void)
+{
+  struct child_process child = {
+    .function = exit_zero,
+    .stdin_fd = REDIRECT_DEV_NULL,
+    .stdout_fd = REDIRECT_DEV_NULL,
+    .stderr_fd = REDIRECT_DEV_NULL,
+    .zygote_safe = true,
+  };
+  struct itimerval every_ms = { { 0, 1000 }, { 0, 1000 } };
+  struct itimerval off = { { 0, 0 }, { 0, 0 } };
+  struct sigaction act = { .sa_handler = ignore_signal };
+  struct sigaction oldact;
+  int status;
+  bool spawned;
+
+  (void) sigemptyset(&act.sa_mask);
+  CU_ASSERT_FATAL(sigaction(SIGALRM, &act, &oldact) == 0);
+  CU_ASSERT_FATAL(zygote_start(slow_prepare));
+
+  CU_ASSERT(setitimer(ITIMER_REAL, &every_ms, NULL) == 0);
+  spawned = zygote_spawn(&child);
+  CU_ASSERT(setitimer(ITIMER_REAL, &off, NULL) == 0);
+
+  CU_ASSERT(spawned);
+
+  if (spawned) {
+    CU_ASSERT(waitpid(child.pid, &status, 0) == child.pid);
+    CU_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+
+  zygote_stop();
+  (void) sigaction(SIGALRM, &oldact, NULL);
+}
+
+CU_TestInfo zygote_tests[] = {
+  { "test_zygote_stdout", test_zygote_stdout },
+  { "test_zygote_signals", test_zygote_signals },
+  CU_TEST_INFO_NULL,
+};
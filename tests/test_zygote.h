@@ -0,0 +1 @@
+extern CU_TestInfo zygote_tests[];
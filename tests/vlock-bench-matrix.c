@@ -0,0 +1,115 @@
+/* vlock-bench-matrix.c -- benchmark for the streams of the cmatrix saver
+ *
+ * Times matrix_step() (see modules/matrix.h) without drawing, from a
+ * regular terminal up to ones far wider than any screen, so the cost per
+ * stream shows, once with all streams moving every frame and once with
+ * asynch.  The streams run for a while before the timing starts, so the
+ * screen is full.  Each result is printed as a single line of JSON, e.g.
+ *
+ *   {"bench":"matrix_step","asynch":false,"cols":4000,"lines":67,...}
+ *
+ * changed is the mean number of cells per frame the renderer is handed.
+ *
+ * Usage: vlock-bench-matrix [frames]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "matrix.h"
+#include "prng.h"
+#include "util.h"
+
+static int frames = 1000;
+
+static int compare_samples(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *) a;
+  uint64_t y = *(const uint64_t *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+static void bench_step(int cols, int lines, bool asynch)
+{
+  uint64_t *samples = calloc(frames, sizeof *samples);
+  struct matrix m = { 0 };
+  struct prng rng;
+  uint64_t total = 0;
+  uint64_t changed = 0;
+  int count = 0;
+
+  prng_seed(&rng, 1);
+
+  if (samples == NULL || !matrix_init(&m, lines, cols, false, &rng)) {
+    fprintf(stderr, "skipping %dx%d: out of memory\n", cols, lines);
+    goto out;
+  }
+
+  m.asynch = asynch;
+
+  for (int i = 0; i < 4 * lines; i++)
+    matrix_step(&m, count = count % MATRIX_TICKS + 1);
+
+  for (int i = 0; i < frames; i++) {
+    uint64_t start = monotonic_ns();
+
+    matrix_step(&m, count = count % MATRIX_TICKS + 1);
+    samples[i] = monotonic_ns() - start;
+    changed += m.nchanged;
+  }
+
+  qsort(samples, frames, sizeof *samples, compare_samples);
+
+  for (int i = 0; i < frames; i++)
+    total += samples[i];
+
+  printf("{\"bench\":\"matrix_step\",\"asynch\":%s,\"cols\":%d,\"lines\":%d"
+         ",\"n\":%d"
+         ",\"changed\":%.1f,\"ns_per_stream\":%.1f,\"mean_us\":%.1f"
+         ",\"min_us\":%.1f,\"p50_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f}\n",
+         asynch ? "true" : "false", cols, lines, frames,
+         (double) changed / frames,
+         (double) total / frames / m.streams, total / 1e3 / frames,
+         samples[0] / 1e3, samples[frames / 2] / 1e3,
+         samples[(frames * 99) / 100] / 1e3, samples[frames - 1] / 1e3);
+  fflush(stdout);
+
+out:
+  matrix_free(&m);
+  free(samples);
+}
+
+int main(int argc, char *argv[])
+{
+  static const struct {
+    int cols;
+    int lines;
+  } sizes[] = {
+    { 80, 25 },
+    { 240, 67 },
+    { 400, 120 },
+    { 1000, 67 },
+    { 4000, 67 },
+    { 16000, 67 },
+    { 64000, 67 },
+  };
+
+  if (argc > 1) {
+    char *end;
+
+    frames = strtol(argv[1], &end, 10);
+
+    if (*end != '\0' || frames <= 0) {
+      fprintf(stderr, "usage: %s [frames]\n", argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  for (size_t i = 0; i < sizeof sizes / sizeof sizes[0]; i++) {
+    bench_step(sizes[i].cols, sizes[i].lines, false);
+    bench_step(sizes[i].cols, sizes[i].lines, true);
+  }
+
+  exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,307 @@
+/* vlock-bench-process.c -- benchmarks for the child process routines of vlock
+ *
+ * Measures how long it takes to create children with create_child(), to
+ * exchange data with them through pipes and to get rid of them with
+ * wait_for_death() and ensure_death().  Each result is printed as a single
+ * line of JSON, e.g.
+ *
+ *   {"bench":"create_child_exec","nofile":1024,"n":100,"mean_us":412.3,...}
+ *
+ * Usage: vlock-bench-process [iterations]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "process.h"
+#include "util.h"
+
+static int iterations = 100;
+
+static int compare_samples(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *) a;
+  uint64_t y = *(const uint64_t *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+/* Print the statistics of the given samples (in nanoseconds). */
+static void report(const char *bench, const char *param, long value,
+                   uint64_t *samples, int n)
+{
+  uint64_t total = 0;
+
+  if (n == 0)
+    return;
+
+  qsort(samples, n, sizeof *samples, compare_samples);
+
+  for (int i = 0; i < n; i++)
+    total += samples[i];
+
+  printf("{\"bench\":\"%s\"", bench);
+
+  if (param != NULL)
+    printf(",\"%s\":%ld", param, value);
+
+  printf(",\"n\":%d,\"mean_us\":%.1f,\"min_us\":%.1f,\"p50_us\":%.1f"
+         ",\"p99_us\":%.1f,\"max_us\":%.1f}\n",
+         n, total / 1e3 / n, samples[0] / 1e3, samples[n / 2] / 1e3,
+         samples[(n * 99) / 100] / 1e3, samples[n - 1] / 1e3);
+  fflush(stdout);
+}
+
+static int return_zero(void *argument)
+{
+  (void) argument;
+  return 0;
+}
+
+static int sleep_forever(void *argument)
+{
+  (void) argument;
+
+  for (;;)
+    pause();
+
+  return 0;
+}
+
+static int ignore_sigterm(void *argument)
+{
+  (void) argument;
+  (void) signal(SIGTERM, SIG_IGN);
+
+  for (;;)
+    pause();
+
+  return 0;
+}
+
+/* Copy stdin to stdout byte by byte. */
+static int echo(void *argument)
+{
+  char c;
+
+  (void) argument;
+
+  while (read(STDIN_FILENO, &c, 1) == 1)
+    if (write(STDOUT_FILENO, &c, 1) != 1)
+      break;
+
+  return 0;
+}
+
+/* Time create_child() for exec or function children with the given soft
+ * limit of file descriptors. */
+static void bench_create_child(bool exec, rlim_t nofile)
+{
+  const char *argv[] = { "/bin/true", NULL };
+  uint64_t *samples = calloc(iterations, sizeof *samples);
+  struct rlimit saved;
+  struct rlimit r;
+  int n = 0;
+
+  if (samples == NULL || getrlimit(RLIMIT_NOFILE, &saved) < 0)
+    goto out;
+
+  if (nofile > saved.rlim_max) {
+    fprintf(stderr, "skipping nofile=%ld: hard limit is %ld\n",
+            (long) nofile, (long) saved.rlim_max);
+    goto out;
+  }
+
+  r.rlim_cur = nofile;
+  r.rlim_max = saved.rlim_max;
+
+  if (setrlimit(RLIMIT_NOFILE, &r) < 0)
+    goto out;
+
+  for (int i = 0; i < iterations; i++) {
+    struct child_process child = {
+      .function = exec ? NULL : return_zero,
+      .path = "/bin/true",
+      .argv = argv,
+      .stdin_fd = REDIRECT_DEV_NULL,
+      .stdout_fd = REDIRECT_DEV_NULL,
+      .stderr_fd = REDIRECT_DEV_NULL,
+    };
+    uint64_t start = monotonic_ns();
+
+    if (!create_child(&child, NULL))
+      break;
+
+    samples[n++] = monotonic_ns() - start;
+    (void) waitpid(child.pid, NULL, 0);
+  }
+
+  (void) setrlimit(RLIMIT_NOFILE, &saved);
+
+  report(exec ? "create_child_exec" : "create_child_function",
+         "nofile", (long) nofile, samples, n);
+
+out:
+  free(samples);
+}
+
+/* Time one byte going to a child and back through pipes. */
+static void bench_pipe_round_trip(void)
+{
+  uint64_t *samples = calloc(iterations, sizeof *samples);
+  struct child_process child = {
+    .function = echo,
+    .stdin_fd = REDIRECT_PIPE,
+    .stdout_fd = REDIRECT_PIPE,
+    .stderr_fd = REDIRECT_DEV_NULL,
+  };
+  int n = 0;
+
+  if (samples == NULL || !create_child(&child, NULL))
+    goto out;
+
+  for (int i = 0; i < iterations; i++) {
+    char c = 'x';
+    uint64_t start = monotonic_ns();
+
+    if (write(child.stdin_fd, &c, 1) != 1 || read(child.stdout_fd, &c, 1) != 1)
+      break;
+
+    samples[n++] = monotonic_ns() - start;
+  }
+
+  (void) close(child.stdin_fd);
+  (void) close(child.stdout_fd);
+  (void) waitpid(child.pid, NULL, 0);
+
+  report("pipe_round_trip", NULL, 0, samples, n);
+
+out:
+  free(samples);
+}
+
+enum teardown_kind {
+  TEARDOWN_COOPERATIVE,
+  TEARDOWN_IGNORE_SIGTERM,
+  TEARDOWN_STOPPED,
+};
+
+/* Time ensure_death() for a child that exits on SIGTERM, ignores it or is
+ * stopped. */
+static void bench_ensure_death(enum teardown_kind kind, int count)
+{
+  static const char *names[] = {
+    "ensure_death_cooperative",
+    "ensure_death_ignore_sigterm",
+    "ensure_death_stopped",
+  };
+  uint64_t *samples = calloc(count, sizeof *samples);
+  int n = 0;
+
+  if (samples == NULL)
+    return;
+
+  for (int i = 0; i < count; i++) {
+    struct child_process child = {
+      .function = kind == TEARDOWN_IGNORE_SIGTERM ? ignore_sigterm
+                                                  : sleep_forever,
+      .stdin_fd = REDIRECT_DEV_NULL,
+      .stdout_fd = REDIRECT_DEV_NULL,
+      .stderr_fd = REDIRECT_DEV_NULL,
+    };
+    uint64_t start;
+
+    if (!create_child(&child, NULL))
+      break;
+
+    /* Give the child time to install its signal handler. */
+    usleep(1000);
+
+    if (kind == TEARDOWN_STOPPED) {
+      (void) kill(child.pid, SIGSTOP);
+      (void) waitpid(child.pid, NULL, WUNTRACED);
+    }
+
+    start = monotonic_ns();
+    ensure_death(child.pid);
+    samples[n++] = monotonic_ns() - start;
+  }
+
+  report(names[kind], NULL, 0, samples, n);
+  free(samples);
+}
+
+/* Time wait_for_death() from SIGTERM until the child is reaped. */
+static void bench_wait_for_death(void)
+{
+  uint64_t *samples = calloc(iterations, sizeof *samples);
+  int n = 0;
+
+  if (samples == NULL)
+    return;
+
+  for (int i = 0; i < iterations; i++) {
+    struct child_process child = {
+      .function = sleep_forever,
+      .stdin_fd = REDIRECT_DEV_NULL,
+      .stdout_fd = REDIRECT_DEV_NULL,
+      .stderr_fd = REDIRECT_DEV_NULL,
+    };
+    uint64_t start;
+
+    if (!create_child(&child, NULL))
+      break;
+
+    start = monotonic_ns();
+    (void) kill(child.pid, SIGTERM);
+
+    if (!wait_for_death(child.pid, 1, 0)) {
+      ensure_death(child.pid);
+      continue;
+    }
+
+    samples[n++] = monotonic_ns() - start;
+  }
+
+  report("wait_for_death_sigterm", NULL, 0, samples, n);
+  free(samples);
+}
+
+int main(int argc, char *argv[])
+{
+  static const rlim_t nofile_limits[] = {
+    256, 1024, 16384, 65536, 1048576
+  };
+
+  if (argc > 1) {
+    char *end;
+
+    iterations = strtol(argv[1], &end, 10);
+
+    if (*end != '\0' || iterations <= 0) {
+      fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  for (size_t i = 0; i < sizeof nofile_limits / sizeof nofile_limits[0]; i++) {
+    bench_create_child(true, nofile_limits[i]);
+    bench_create_child(false, nofile_limits[i]);
+  }
+
+  bench_pipe_round_trip();
+  bench_wait_for_death();
+  bench_ensure_death(TEARDOWN_COOPERATIVE, iterations);
+  /* These may sit out the whole grace period of ensure_death(). */
+  bench_ensure_death(TEARDOWN_IGNORE_SIGTERM, MIN(iterations, 5));
+  bench_ensure_death(TEARDOWN_STOPPED, MIN(iterations, 5));
+
+  exit(EXIT_SUCCESS);
+}
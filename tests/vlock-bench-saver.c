@@ -0,0 +1,385 @@
+/* vlock-bench-saver.c -- benchmark for the screen saver modules of vlock
+ *
+ * Runs the render loop of saver modules for a fixed number of frames at a
+ * fixed geometry and random seed, without a real terminal, and prints the
+ * statistics the savers collect in benchmark mode (see modules/bench.h), one
+ * line of JSON per saver, e.g.
+ *
+ *   {"saver":"cmatrix","frames":500,"bytes":{"mean":612.0,...},...}
+ *
+ * The frames go to a pty, which is drained and discarded, or to a file.
+ *
+ * Like the zygote, the harness calls the module's vlock_prepare before the
+ * saver is started, unless -c asks for a cold start.  first_frame_us is the
+ * time from vlock_save to the end of the first frame.
+ *
+ * With -r the saver is started twice from one vlock_prepare, like two
+ * children cloned from the zygote, without VLOCK_SEED.  The check fails if
+ * both drew the same frames.
+ *
+ * Usage: vlock-bench-saver [-c] [-r] [-n frames] [-s seed] [-g COLSxROWS]
+ *                          [-t term] [-o file] [-d module-dir] saver...
+ */
+
+#if !defined(__FreeBSD__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <dlfcn.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/ioctl.h>
+
+#include "powersave.h"
+#include "util.h"
+
+static long frames = 500;
+static unsigned long seed = 1;
+static int cols = 80;
+static int rows = 25;
+static const char *term = "linux";
+static const char *output_file = NULL;
+static const char *module_dir = VLOCK_BENCH_MODULE_DIR;
+static bool cold = false;
+static bool replay = false;
+
+/* The modules ask vlock-main how far to slow down; a benchmark never does. */
+unsigned int powersave_max_fps(void)
+{
+  return 0;
+}
+
+/* Open the terminal the saver draws on.  Returns the descriptor for the
+ * saver and stores the one to drain in *master, -1 for a file. */
+static int open_output(int *master)
+{
+  struct winsize size = { .ws_row = rows, .ws_col = cols };
+  int slave;
+
+  *master = -1;
+
+  if (output_file != NULL)
+    return open(output_file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+  *master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+
+  if (*master < 0 || grantpt(*master) < 0 || unlockpt(*master) < 0)
+    return -1;
+
+  slave = open(ptsname(*master), O_RDWR | O_NOCTTY | O_CLOEXEC);
+
+  if (slave >= 0)
+    (void) ioctl(slave, TIOCSWINSZ, &size);
+
+  return slave;
+}
+
+/* Start the saver like vlock-main would and wait for it to finish its
+ * frames. */
+static void start_saver(const char *path, bool (*save)(void **))
+{
+  char value[32];
+  void *ctx = NULL;
+
+  (void) snprintf(value, sizeof value, "%" PRIu64, monotonic_ns());
+  (void) setenv("VLOCK_BENCH_START", value, 1);
+
+  if (save == NULL || !save(&ctx)) {
+    fprintf(stderr, "%s: could not start the saver\n", path);
+    _exit(EXIT_FAILURE);
+  }
+
+  while (wait(NULL) > 0 || errno == EINTR)
+    ;
+}
+
+/* Start a clone of the prepared saver with its frames going to a file of
+ * its own.  Returns the file, or NULL if the clone failed. */
+static FILE *clone_saver(const char *path, bool (*save)(void **))
+{
+  FILE *frames = tmpfile();
+  int status;
+  pid_t pid;
+
+  if (frames == NULL)
+    return NULL;
+
+  pid = fork();
+
+  if (pid == 0) {
+    (void) dup2(fileno(frames), STDOUT_FILENO);
+    start_saver(path, save);
+    _exit(EXIT_SUCCESS);
+  }
+
+  if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status)
+      || WEXITSTATUS(status) != EXIT_SUCCESS) {
+    (void) fclose(frames);
+    return NULL;
+  }
+
+  rewind(frames);
+
+  return frames;
+}
+
+/* Whether two clones of the prepared saver drew different frames. */
+static bool clones_diverge(const char *path, bool (*save)(void **))
+{
+  FILE *a = clone_saver(path, save);
+  FILE *b = clone_saver(path, save);
+  bool diverge = false;
+  int c;
+
+  if (a == NULL || b == NULL) {
+    fprintf(stderr, "%s: could not start the saver twice\n", path);
+  } else {
+    do
+      diverge = (c = getc(a)) != getc(b);
+    while (!diverge && c != EOF);
+
+    if (!diverge)
+      fprintf(stderr, "%s: two starts drew the same frames\n", path);
+  }
+
+  if (a != NULL)
+    (void) fclose(a);
+
+  if (b != NULL)
+    (void) fclose(b);
+
+  return diverge;
+}
+
+/* Run in the child: prepare the saver like the zygote would and start it. */
+static void run_saver(const char *path)
+{
+  char value[32];
+  void *module;
+  bool (*save)(void **);
+  void (*prepare)(void);
+
+  (void) snprintf(value, sizeof value, "%ld", frames);
+  (void) setenv("VLOCK_BENCH_FRAMES", value, 1);
+  (void) snprintf(value, sizeof value, "%lu", seed);
+  if (replay)
+    (void) unsetenv("VLOCK_SEED");
+  else
+    (void) setenv("VLOCK_SEED", value, 1);
+
+  (void) snprintf(value, sizeof value, "%d", rows);
+  (void) setenv("LINES", value, 1);
+  (void) snprintf(value, sizeof value, "%d", cols);
+  (void) setenv("COLUMNS", value, 1);
+  (void) setenv("TERM", term, 1);
+
+  /* Only savers in their own process go through the frame clock. */
+  (void) setenv("VLOCK_WETPIPES_FORK", "1", 1);
+  (void) setenv("CACA_DRIVER", "ncurses", 0);
+  (void) setenv("VLOCK_VCSA", "0", 0);
+  (void) unsetenv("VLOCK_INFO_BOX");
+
+  module = dlopen(path, RTLD_NOW | RTLD_GLOBAL);
+
+  if (module == NULL) {
+    fprintf(stderr, "%s\n", dlerror());
+    _exit(EXIT_FAILURE);
+  }
+
+  *(void **) &save = dlsym(module, "vlock_save");
+  *(void **) &prepare = dlsym(module, "vlock_prepare");
+
+  if (prepare != NULL && !cold)
+    prepare();
+
+  if (replay)
+    _exit(clones_diverge(path, save) ? EXIT_SUCCESS : EXIT_FAILURE);
+
+  start_saver(path, save);
+  _exit(EXIT_SUCCESS);
+}
+
+/* Print the report lines in the saver's stderr to stdout and everything
+ * else to stderr.  Returns true if there was a report. */
+static bool print_report(const char *name, char *text)
+{
+  bool found = false;
+
+  for (char *line = strtok(text, "\n"); line != NULL;
+       line = strtok(NULL, "\n")) {
+    if (strncmp(line, "{\"saver\"", 8) == 0) {
+      puts(line);
+      found = true;
+    } else {
+      fprintf(stderr, "%s: %s\n", name, line);
+    }
+  }
+
+  fflush(stdout);
+
+  return found;
+}
+
+static bool bench_saver(const char *name)
+{
+  char *path;
+  int report[2];
+  int master;
+  int output = open_output(&master);
+  char *text = NULL;
+  size_t length = 0;
+  bool done = false;
+  int status = 0;
+  pid_t pid;
+  bool result;
+
+  if (output < 0 || pipe2(report, O_CLOEXEC) < 0) {
+    perror("vlock-bench-saver: cannot open the output");
+    return false;
+  }
+
+  if (strchr(name, '/') != NULL)
+    path = strdup(name);
+  else if (asprintf(&path, "%s/%s.so", module_dir, name) < 0)
+    path = NULL;
+
+  if (path == NULL) {
+    perror("vlock-bench-saver");
+    return false;
+  }
+
+  pid = fork();
+
+  if (pid == 0) {
+    int devnull = open("/dev/null", O_RDONLY);
+
+    (void) setsid();
+    (void) dup2(master >= 0 ? output : devnull, STDIN_FILENO);
+    (void) dup2(output, STDOUT_FILENO);
+    (void) dup2(report[1], STDERR_FILENO);
+    run_saver(path);
+  }
+
+  free(path);
+  (void) close(output);
+  (void) close(report[1]);
+
+  /* Drain the pty, so the saver never blocks on it, until the saver and
+   * its child closed their stderr. */
+  while (pid > 0 && !done) {
+    struct pollfd fds[2] = {
+      { .fd = report[0], .events = POLLIN },
+      { .fd = master, .events = POLLIN },
+    };
+    char buf[65536];
+    ssize_t n;
+
+    if (poll(fds, master >= 0 ? 2 : 1, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+
+      break;
+    }
+
+    /* Reading fails once the saver closed the pty. */
+    if (master >= 0 && fds[1].revents != 0
+        && read(master, buf, sizeof buf) <= 0) {
+      (void) close(master);
+      master = -1;
+    }
+
+    if (fds[0].revents != 0) {
+      n = read(report[0], buf, sizeof buf);
+
+      if (n <= 0) {
+        done = true;
+      } else {
+        text = realloc(text, length + n + 1);
+        memcpy(text + length, buf, n);
+        length += n;
+        text[length] = '\0';
+      }
+    }
+  }
+
+  if (pid > 0)
+    (void) waitpid(pid, &status, 0);
+
+  if (master >= 0)
+    (void) close(master);
+
+  (void) close(report[0]);
+
+  result = text != NULL && print_report(name, text)
+    && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+
+  if (!result)
+    fprintf(stderr, "vlock-bench-saver: %s failed\n", name);
+
+  free(text);
+
+  return result;
+}
+
+static void usage(const char *argv0)
+{
+  fprintf(stderr,
+          "usage: %s [-c] [-r] [-n frames] [-s seed] [-g COLSxROWS] [-t term]"
+          " [-o file] [-d module-dir] saver...\n", argv0);
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+  bool ok = true;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "crn:s:g:t:o:d:")) != -1) {
+    switch (opt) {
+    case 'c':
+      cold = true;
+      break;
+    case 'r':
+      replay = true;
+      break;
+    case 'n':
+      frames = strtol(optarg, NULL, 10);
+      break;
+    case 's':
+      seed = strtoul(optarg, NULL, 10);
+      break;
+    case 'g':
+      if (sscanf(optarg, "%dx%d", &cols, &rows) != 2)
+        usage(argv[0]);
+      break;
+    case 't':
+      term = optarg;
+      break;
+    case 'o':
+      output_file = optarg;
+      break;
+    case 'd':
+      module_dir = optarg;
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+
+  if (optind == argc || frames <= 0 || cols <= 0 || rows <= 0)
+    usage(argv[0]);
+
+  for (int i = optind; i < argc; i++)
+    ok = bench_saver(argv[i]) && ok;
+
+  exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+}
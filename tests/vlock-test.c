@@ -7,11 +7,21 @@
 #include "test_tsort.h"
 #include "test_util.h"
 #include "test_process.h"
+#include "test_vcsa.h"
+#include "test_prng.h"
+#include "test_matrix.h"
+#include "test_events.h"
+#include "test_zygote.h"
 
 CU_SuiteInfo vlock_test_suites[] = {
   { "test_tsort", NULL, NULL, tsort_tests },
   { "test_util", NULL, NULL, util_tests },
   { "test_process", NULL, NULL, process_tests },
+  { "test_vcsa", NULL, NULL, vcsa_tests },
+  { "test_prng", NULL, NULL, prng_tests },
+  { "test_matrix", NULL, NULL, matrix_tests },
+  { "test_events", NULL, NULL, events_tests },
+  { "test_zygote", NULL, NULL, zygote_tests },
   CU_SUITE_INFO_NULL,
 };
 